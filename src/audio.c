@@ -9,18 +9,166 @@
 #define TOTAL_CHANNELS 2
 #define SIZE_OF_FRAME (TOTAL_CHANNELS * sizeof(int16_t))
 
+/* The null output pretends to be a typical sound card with a 10ms buffer. */
+#define NULL_OUTPUT_SAMPLE_RATE 48000
+#define NULL_OUTPUT_BUFFER_FRAMES (NULL_OUTPUT_SAMPLE_RATE / 100)
+
+/* The latency target is re-evaluated after this many pushes (roughly two seconds' worth of frames). */
+#define LATENCY_WINDOW_PUSHES 120
+/* A gap between pushes longer than this means that the emulator was paused, so any underruns are not the latency target's fault. */
+#define LATENCY_WINDOW_GAP_MILLISECONDS 100
+/* The target must survive this many windows in a row without an underrun before it is lowered. */
+#define LATENCY_SHRINK_WINDOWS 5
+
+/* Cores are allowed to ask for up to this much latency. */
+#define MAXIMUM_REQUESTED_LATENCY_MILLISECONDS 512
+
+/* The most times that the audio callback will be asked for more audio in one go, in case it is not producing enough. */
+#define MAX_CALLBACK_CALLS 16
+
+/* Resampled audio is gathered into blocks of this many frames before being written to the ring buffer. */
+#define OUTPUT_BLOCK_FRAMES 0x200
+
 static cc_bool sdl_already_initialised;
 static cc_bool initialised;
 static ClownResampler_Precomputed resampler_precomputed;
 
+static cc_bool null_output;
+static cc_bool null_output_resample;
+
+static unsigned int minimum_latency_milliseconds = 20;
+static unsigned int maximum_latency_milliseconds = 200;
+
+static cc_u32f MillisecondsToFrames(const Audio_Stream* const stream, const unsigned int milliseconds)
+{
+	return (cc_u32f)((Uint64)stream->output_sample_rate * milliseconds / 1000);
+}
+
 static cc_u32f GetTargetFrames(const Audio_Stream* const stream)
 {
-	return CLOWNRESAMPLER_MAX(stream->total_buffer_frames * 2, stream->output_sample_rate / 20); /* 50ms */
+	return stream->target_frames;
+}
+
+static void ApplyLatencyBounds(Audio_Stream* const stream)
+{
+	/* The queue drains a whole device buffer at a time, so anything less than two of them is bound to underrun. */
+	stream->minimum_target_frames = CLOWNRESAMPLER_MAX(stream->total_buffer_frames * 2, MillisecondsToFrames(stream, minimum_latency_milliseconds));
+	stream->minimum_target_frames = CLOWNRESAMPLER_MAX(stream->minimum_target_frames, stream->requested_minimum_target_frames);
+	stream->maximum_target_frames = CLOWNRESAMPLER_MAX(stream->minimum_target_frames, MillisecondsToFrames(stream, maximum_latency_milliseconds));
+	stream->target_frames = CLOWNRESAMPLER_MAX(stream->minimum_target_frames, CLOWNRESAMPLER_MIN(stream->target_frames, stream->maximum_target_frames));
+}
+
+static void InitLatencyTarget(Audio_Stream* const stream)
+{
+	stream->requested_minimum_target_frames = 0;
+	stream->target_frames = 0;
+	ApplyLatencyBounds(stream);
+
+	SDL_AtomicSet(&stream->underruns, 0);
+	stream->starved = cc_true; /* The queue starts empty, which is not the emulator's fault. */
+	stream->latency_window_open = cc_false;
+	stream->good_windows = 0;
+}
+
+static void OpenLatencyWindow(Audio_Stream* const stream)
+{
+	stream->latency_window_open = cc_true;
+	stream->window_pushes = 0;
+	stream->window_queued_total = 0.0;
+	stream->window_queued_squared_total = 0.0;
+
+	/* Forget about any underruns from before the window. */
+	SDL_AtomicSet(&stream->underruns, 0);
 }
 
-static cc_u32f GetTotalQueuedFrames(const Audio_Stream* const stream)
+static void UpdateLatencyTarget(Audio_Stream* const stream, const cc_u32f queued_frames)
 {
-	return SDL_GetQueuedAudioSize(stream->audio_device) / SIZE_OF_FRAME;
+	const Uint32 ticks = SDL_GetTicks();
+
+	if (!stream->latency_window_open || ticks - stream->last_push_ticks > LATENCY_WINDOW_GAP_MILLISECONDS)
+		OpenLatencyWindow(stream);
+
+	stream->last_push_ticks = ticks;
+
+	stream->window_queued_total += queued_frames;
+	stream->window_queued_squared_total += (double)queued_frames * queued_frames;
+
+	if (++stream->window_pushes == LATENCY_WINDOW_PUSHES)
+	{
+		const int underruns = SDL_AtomicSet(&stream->underruns, 0);
+		const double mean = stream->window_queued_total / LATENCY_WINDOW_PUSHES;
+		const double variance = stream->window_queued_squared_total / LATENCY_WINDOW_PUSHES - mean * mean;
+		const double standard_deviation = variance > 0.0 ? SDL_sqrt(variance) : 0.0;
+
+		if (underruns != 0)
+		{
+			/* The device ran dry, so back off quickly. */
+			stream->target_frames += stream->target_frames / 4;
+			stream->good_windows = 0;
+		}
+		else if (++stream->good_windows >= LATENCY_SHRINK_WINDOWS)
+		{
+			/* Only creep downwards if the queue never gets close to running out, even when it is at its shallowest. */
+			if (mean - standard_deviation * 3.0 > stream->total_buffer_frames)
+				stream->target_frames -= stream->target_frames / 8;
+
+			stream->good_windows = 0;
+		}
+
+		stream->target_frames = CLOWNRESAMPLER_MAX(stream->minimum_target_frames, CLOWNRESAMPLER_MIN(stream->target_frames, stream->maximum_target_frames));
+
+		OpenLatencyWindow(stream);
+	}
+}
+
+static cc_u32f GetTotalQueuedFrames(Audio_Stream* const stream)
+{
+	/* The null output consumes audio instantly, so pretend that the queue is always exactly where we want it. */
+	if (null_output)
+		return GetTargetFrames(stream);
+
+	/* This only reads the ring buffer's indices, so there is no need to take SDL's audio lock. */
+	return RingBuffer_GetTotalReadable(&stream->ring_buffer);
+}
+
+static void AudioCallback(void* const user_data, Uint8* const stream, const int length)
+{
+	Audio_Stream* const audio_stream = (Audio_Stream*)user_data;
+	const size_t total_frames = (size_t)length / SIZE_OF_FRAME;
+	size_t frames_read;
+
+	if (audio_stream->callback != NULL)
+	{
+		unsigned int i;
+
+		/* Generate audio on demand, giving up if the callback stops producing any. */
+		for (i = 0; i < MAX_CALLBACK_CALLS; ++i)
+		{
+			const size_t frames_queued = RingBuffer_GetTotalReadable(&audio_stream->ring_buffer);
+
+			if (frames_queued >= total_frames)
+				break;
+
+			audio_stream->callback(audio_stream->callback_user_data);
+
+			if (RingBuffer_GetTotalReadable(&audio_stream->ring_buffer) == frames_queued)
+				break;
+		}
+	}
+
+	frames_read = RingBuffer_Read(&audio_stream->ring_buffer, stream, total_frames);
+
+	/* If the emulator has fallen behind, then pad the rest with silence. */
+	/* Only the start of a shortage counts as an underrun, so that the emulator being paused does not rack up thousands of them. */
+	if (frames_read != total_frames && !audio_stream->starved)
+	{
+		SDL_AtomicAdd(&audio_stream->underruns, 1);
+		SDL_AtomicAdd(&audio_stream->total_underruns, 1);
+	}
+
+	audio_stream->starved = frames_read != total_frames;
+
+	SDL_memset(&stream[frames_read * SIZE_OF_FRAME], 0, (size_t)length - frames_read * SIZE_OF_FRAME);
 }
 
 /*************
@@ -39,12 +187,39 @@ cc_bool Audio_Init(void)
 	return initialised;
 }
 
+cc_bool Audio_InitNull(const cc_bool resample)
+{
+	null_output = cc_true;
+	null_output_resample = resample;
+
+	/* The audio subsystem is never used, so make sure that it is not shut down either. */
+	sdl_already_initialised = cc_true;
+	initialised = cc_true;
+
+	ClownResampler_Precompute(&resampler_precomputed);
+
+	return initialised;
+}
+
 void Audio_Deinit(void)
 {
 	if (!sdl_already_initialised)
 		SDL_QuitSubSystem(SDL_INIT_AUDIO);
 
 	initialised = cc_false;
+	null_output = cc_false;
+}
+
+void Audio_SetLatencyBounds(const unsigned int minimum_milliseconds, const unsigned int maximum_milliseconds)
+{
+	minimum_latency_milliseconds = minimum_milliseconds;
+	maximum_latency_milliseconds = maximum_milliseconds;
+}
+
+cc_bool Audio_SupportsCallbacks(void)
+{
+	/* The null output has no audio thread to call them from. */
+	return initialised && !null_output;
 }
 
 /***************
@@ -53,7 +228,23 @@ void Audio_Deinit(void)
 
 cc_bool Audio_StreamCreate(Audio_Stream *stream, unsigned long sample_rate)
 {
-	if (initialised)
+	if (initialised && null_output)
+	{
+		stream->audio_device = 0;
+		stream->callback = NULL;
+		stream->input_sample_rate = sample_rate;
+		stream->output_sample_rate = NULL_OUTPUT_SAMPLE_RATE;
+		stream->total_buffer_frames = NULL_OUTPUT_BUFFER_FRAMES;
+
+		/* The null output never underruns, so the target is only used to scale the pretend queue depth. */
+		InitLatencyTarget(stream);
+		Audio_StreamResetStatistics(stream);
+
+		ClownResampler_HighLevel_Init(&stream->resampler, TOTAL_CHANNELS, stream->input_sample_rate * 2, stream->output_sample_rate, stream->output_sample_rate);
+
+		return cc_true;
+	}
+	else if (initialised)
 	{
 		SDL_AudioSpec want, have;
 
@@ -61,6 +252,9 @@ cc_bool Audio_StreamCreate(Audio_Stream *stream, unsigned long sample_rate)
 		want.freq = sample_rate;
 		want.format = AUDIO_S16SYS;
 		want.channels = TOTAL_CHANNELS;
+		want.callback = AudioCallback;
+		want.userdata = stream;
+		stream->callback = NULL;
 		/* We want a 10ms buffer (this value must be a power of two). */
 		want.samples = 1;
 		while (want.samples < want.freq / (1000 / 10))
@@ -74,12 +268,22 @@ cc_bool Audio_StreamCreate(Audio_Stream *stream, unsigned long sample_rate)
 			stream->output_sample_rate = have.freq;
 			stream->total_buffer_frames = have.samples;
 
-			SDL_PauseAudioDevice(stream->audio_device, 0);
+			InitLatencyTarget(stream);
+			Audio_StreamResetStatistics(stream);
 
-			/* Specify the greatest possible downsample. */
-			ClownResampler_HighLevel_Init(&stream->resampler, TOTAL_CHANNELS, stream->input_sample_rate * 2, stream->output_sample_rate, stream->output_sample_rate);
+			/* The ring buffer must be able to hold as much audio as the dynamic rate control will ever let build up, plus one more push's worth. */
+			if (RingBuffer_Create(&stream->ring_buffer, SIZE_OF_FRAME, CLOWNRESAMPLER_MAX(stream->maximum_target_frames, MillisecondsToFrames(stream, MAXIMUM_REQUESTED_LATENCY_MILLISECONDS)) * 3))
+			{
+				/* Specify the greatest possible downsample. */
+				ClownResampler_HighLevel_Init(&stream->resampler, TOTAL_CHANNELS, stream->input_sample_rate * 2, stream->output_sample_rate, stream->output_sample_rate);
 
-			return cc_true;
+				/* The callback can fire as soon as the device is unpaused, so everything must be ready beforehand. */
+				SDL_PauseAudioDevice(stream->audio_device, 0);
+
+				return cc_true;
+			}
+
+			SDL_CloseAudioDevice(stream->audio_device);
 		}
 	}
 
@@ -88,16 +292,75 @@ cc_bool Audio_StreamCreate(Audio_Stream *stream, unsigned long sample_rate)
 
 void Audio_StreamDestroy(Audio_Stream *stream)
 {
-	SDL_CloseAudioDevice(stream->audio_device);
+	if (stream->audio_device != 0)
+	{
+		/* This stops the callback, so the ring buffer is safe to free afterwards. */
+		SDL_CloseAudioDevice(stream->audio_device);
+		RingBuffer_Destroy(&stream->ring_buffer);
+	}
+}
+
+static void RecordQueueDepth(Audio_Stream* const stream, const cc_u32f queued_frames, const cc_u32f target_frames)
+{
+	Audio_Statistics* const statistics = &stream->statistics;
+	const size_t bucket = (size_t)((Uint64)queued_frames * (AUDIO_QUEUE_HISTOGRAM_BUCKETS / 2) / target_frames);
+
+	++statistics->total_pushes;
+	++statistics->queue_depth_histogram[CLOWNRESAMPLER_MIN(bucket, AUDIO_QUEUE_HISTOGRAM_BUCKETS - 1)];
+	statistics->queued_frames = queued_frames;
+	statistics->target_frames = target_frames;
+}
+
+static void RecordRatio(Audio_Stream* const stream, const double ratio)
+{
+	Audio_Statistics* const statistics = &stream->statistics;
+
+	if (stream->total_ratios == 0)
+	{
+		statistics->minimum_ratio = ratio;
+		statistics->maximum_ratio = ratio;
+	}
+	else
+	{
+		statistics->minimum_ratio = CLOWNRESAMPLER_MIN(statistics->minimum_ratio, ratio);
+		statistics->maximum_ratio = CLOWNRESAMPLER_MAX(statistics->maximum_ratio, ratio);
+	}
+
+	statistics->ratio = ratio;
+	stream->ratio_total += ratio;
+	++stream->total_ratios;
+}
+
+static void PublishStatistics(Audio_Stream* const stream)
+{
+	/* Readers retry if the number is odd or changes while they are copying. */
+	SDL_AtomicAdd(&stream->published_statistics_sequence, 1);
+	SDL_MemoryBarrierRelease();
+
+	stream->published_statistics = stream->statistics;
+	stream->published_statistics.mean_ratio = stream->total_ratios == 0 ? 0.0 : stream->ratio_total / stream->total_ratios;
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicAdd(&stream->published_statistics_sequence, 1);
 }
 
 typedef struct CallbackUserData
 {
 	const int16_t *data;
 	size_t frames;
-	SDL_AudioDeviceID audio_device;
+	RingBuffer *ring_buffer;
+	Audio_Statistics *statistics;
+	Sint16 output_block[OUTPUT_BLOCK_FRAMES * TOTAL_CHANNELS];
+	size_t output_block_frames;
 } CallbackUserData;
 
+static void FlushOutputBlock(CallbackUserData* const data)
+{
+	/* Anything that does not fit is dropped, the same as when the queue is too full to resample into at all. */
+	data->statistics->overflowed_frames += data->output_block_frames - RingBuffer_Write(data->ring_buffer, data->output_block, data->output_block_frames);
+	data->output_block_frames = 0;
+}
+
 static size_t InputCallback(void* const user_data, cc_s16l* const buffer, const size_t total_frames)
 {
 	CallbackUserData* const data = (CallbackUserData*)user_data;
@@ -114,13 +377,24 @@ static size_t InputCallback(void* const user_data, cc_s16l* const buffer, const
 static cc_bool OutputCallback(void* const user_data, const cc_s32f* const frame, const cc_u8f total_samples)
 {
 	CallbackUserData* const data = (CallbackUserData*)user_data;
-	Sint16 s16_frame[TOTAL_CHANNELS];
+	Sint16* const s16_frame = &data->output_block[data->output_block_frames * TOTAL_CHANNELS];
 
 	(void)total_samples;
 
 	s16_frame[0] = frame[0];
 	s16_frame[1] = frame[1];
-	SDL_QueueAudio(data->audio_device, s16_frame, sizeof(s16_frame));
+
+	if (++data->output_block_frames == OUTPUT_BLOCK_FRAMES)
+		FlushOutputBlock(data);
+
+	return cc_true;
+}
+
+static cc_bool NullOutputCallback(void* const user_data, const cc_s32f* const frame, const cc_u8f total_samples)
+{
+	(void)user_data;
+	(void)frame;
+	(void)total_samples;
 
 	return cc_true;
 }
@@ -130,8 +404,21 @@ size_t Audio_StreamPushFrames(Audio_Stream *stream, const int16_t *data, size_t
 	const cc_u32f target_frames = GetTargetFrames(stream);
 	const cc_u32f queued_frames = GetTotalQueuedFrames(stream);
 
+	if (null_output && !null_output_resample)
+		return frames;
+
+	/* Audio that is generated on demand does not build up, so there is nothing to tune. */
+	if (!null_output && stream->callback == NULL)
+		UpdateLatencyTarget(stream, queued_frames);
+
+	RecordQueueDepth(stream, queued_frames, target_frames);
+
 	/* If there is too much audio, just drop it because the dynamic rate control will be unable to handle it. */
-	if (queued_frames < target_frames * 2)
+	if (queued_frames >= target_frames * 2)
+	{
+		stream->statistics.dropped_frames += frames;
+	}
+	else
 	{
 		CallbackUserData callback_user_data;
 
@@ -140,15 +427,103 @@ size_t Audio_StreamPushFrames(Audio_Stream *stream, const int16_t *data, size_t
 		const cc_u32f denominator = target_frames * 0x100; /* The number here is the inverse of the formula's 'd' value. */
 		const cc_u32f numerator = queued_frames - target_frames + denominator;
 
-		const cc_u32f adjusted_input_sample_rate = (Uint64)stream->input_sample_rate * numerator / denominator;
+		/* Audio that is generated on demand is already in sync with the device, so it does not need any rate control. */
+		const cc_u32f adjusted_input_sample_rate = stream->callback != NULL ? stream->input_sample_rate : CLOWNRESAMPLER_MIN((Uint64)stream->input_sample_rate * numerator / denominator, stream->input_sample_rate * 2);
 
 		callback_user_data.data = data;
 		callback_user_data.frames = frames;
-		callback_user_data.audio_device = stream->audio_device;
+		callback_user_data.ring_buffer = &stream->ring_buffer;
+		callback_user_data.statistics = &stream->statistics;
+		callback_user_data.output_block_frames = 0;
 
-		ClownResampler_HighLevel_Adjust(&stream->resampler, CLOWNRESAMPLER_MIN(adjusted_input_sample_rate, stream->input_sample_rate * 2), stream->output_sample_rate, stream->output_sample_rate);
-		ClownResampler_HighLevel_Resample(&stream->resampler, &resampler_precomputed, InputCallback, OutputCallback, &callback_user_data);
+		RecordRatio(stream, (double)adjusted_input_sample_rate / stream->input_sample_rate);
+
+		ClownResampler_HighLevel_Adjust(&stream->resampler, adjusted_input_sample_rate, stream->output_sample_rate, stream->output_sample_rate);
+		ClownResampler_HighLevel_Resample(&stream->resampler, &resampler_precomputed, InputCallback, null_output ? NullOutputCallback : OutputCallback, &callback_user_data);
+
+		if (!null_output)
+			FlushOutputBlock(&callback_user_data);
 	}
 
+	PublishStatistics(stream);
+
 	return frames;
 }
+
+void Audio_StreamSetLatency(Audio_Stream* const stream, const unsigned int milliseconds)
+{
+	stream->target_frames = CLOWNRESAMPLER_MAX(stream->minimum_target_frames, CLOWNRESAMPLER_MIN(MillisecondsToFrames(stream, milliseconds), stream->maximum_target_frames));
+}
+
+unsigned int Audio_StreamGetLatency(const Audio_Stream* const stream)
+{
+	/* Round up, so that saving and restoring the latency does not slowly shrink it. */
+	return (unsigned int)(((Uint64)stream->target_frames * 1000 + stream->output_sample_rate - 1) / stream->output_sample_rate);
+}
+
+/* Safe to call from any thread, even while another one is pushing audio. */
+void Audio_StreamGetStatistics(Audio_Stream* const stream, Audio_Statistics* const statistics)
+{
+	int sequence;
+
+	do
+	{
+		sequence = SDL_AtomicGet(&stream->published_statistics_sequence);
+		SDL_MemoryBarrierAcquire();
+
+		*statistics = stream->published_statistics;
+
+		SDL_MemoryBarrierAcquire();
+	} while ((sequence & 1) != 0 || SDL_AtomicGet(&stream->published_statistics_sequence) != sequence);
+
+	statistics->underruns = (unsigned long)SDL_AtomicGet(&stream->total_underruns);
+}
+
+void Audio_StreamResetStatistics(Audio_Stream* const stream)
+{
+	SDL_zero(stream->statistics);
+	stream->ratio_total = 0.0;
+	stream->total_ratios = 0;
+	SDL_AtomicSet(&stream->total_underruns, 0);
+	stream->reported_underruns = 0;
+
+	PublishStatistics(stream);
+}
+
+void Audio_StreamSetCallback(Audio_Stream* const stream, const Audio_Callback callback, void* const user_data)
+{
+	/* The device callback runs with this lock held, so the callback cannot change in the middle of being used. */
+	SDL_LockAudioDevice(stream->audio_device);
+	stream->callback = callback;
+	stream->callback_user_data = user_data;
+	SDL_UnlockAudioDevice(stream->audio_device);
+}
+
+/* Zero restores the default minimum. */
+void Audio_StreamSetMinimumLatency(Audio_Stream* const stream, const unsigned int milliseconds)
+{
+	stream->requested_minimum_target_frames = MillisecondsToFrames(stream, CLOWNRESAMPLER_MIN(milliseconds, MAXIMUM_REQUESTED_LATENCY_MILLISECONDS));
+	ApplyLatencyBounds(stream);
+}
+
+/* Returns false if the buffer is not being fed by the emulator, in which case its occupancy means nothing. */
+cc_bool Audio_StreamGetBufferStatus(Audio_Stream* const stream, unsigned int* const occupancy, cc_bool* const underrun_likely)
+{
+	if (null_output || stream->callback != NULL)
+	{
+		return cc_false;
+	}
+	else
+	{
+		const cc_u32f queued_frames = GetTotalQueuedFrames(stream);
+		const unsigned long underruns = (unsigned long)SDL_AtomicGet(&stream->total_underruns);
+
+		/* Audio starts being dropped at twice the target, so that is what counts as full. */
+		*occupancy = (unsigned int)CLOWNRESAMPLER_MIN((Uint64)queued_frames * 100 / (stream->target_frames * 2), 100);
+		*underrun_likely = underruns != stream->reported_underruns || queued_frames < stream->total_buffer_frames;
+
+		stream->reported_underruns = underruns;
+
+		return cc_true;
+	}
+}
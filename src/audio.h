@@ -7,20 +7,72 @@
 
 #include "clowncommon/clowncommon.h"
 
+#include "ring_buffer.h"
+
 #define CLOWNRESAMPLER_STATIC
 #define CLOWNRESAMPLER_NO_HIGH_LEVEL_RESAMPLE_END
 #include "clownresampler/clownresampler.h"
 
+/* Called from SDL's audio thread whenever the device needs more audio than is queued. */
+typedef void (*Audio_Callback)(void *user_data);
+
+/* Each bucket covers a quarter of the latency target, up to twice the target, which is where audio starts getting dropped. */
+#define AUDIO_QUEUE_HISTOGRAM_BUCKETS 8
+
+typedef struct Audio_Statistics
+{
+	unsigned long total_pushes;
+	unsigned long dropped_frames;    /* Input frames that were thrown away because the queue was too full. */
+	unsigned long overflowed_frames; /* Output frames that did not fit in the ring buffer. */
+	unsigned long underruns;         /* Times that the device wanted audio that was not there yet. */
+	unsigned long queue_depth_histogram[AUDIO_QUEUE_HISTOGRAM_BUCKETS];
+	cc_u32f queued_frames, target_frames;
+	/* The dynamic rate control's adjustment, as a multiple of the core's sample rate. */
+	double ratio, minimum_ratio, maximum_ratio, mean_ratio;
+} Audio_Statistics;
+
 typedef struct Audio_Stream
 {
 	SDL_AudioDeviceID audio_device;
 	cc_u32f input_sample_rate, output_sample_rate, total_buffer_frames;
 	ClownResampler_HighLevel_State resampler;
-} Audio_Stream; 
+	RingBuffer ring_buffer; /* Filled by the emulator, drained by SDL's audio thread. */
+	Audio_Callback callback;
+	void *callback_user_data;
+
+	/* The amount of audio that the dynamic rate control aims to keep queued, which is tuned according to how well the device is being kept fed. */
+	cc_u32f target_frames, minimum_target_frames, maximum_target_frames;
+	cc_u32f requested_minimum_target_frames; /* Set by the core. */
+	SDL_atomic_t underruns;
+	cc_bool latency_window_open;
+	Uint32 last_push_ticks;
+	unsigned int window_pushes, good_windows;
+	double window_queued_total, window_queued_squared_total;
+
+	Audio_Statistics statistics;
+	double ratio_total;
+	unsigned long total_ratios;
+	/* A copy of the statistics for other threads, which can be read without stopping whichever thread pushes the audio. */
+	Audio_Statistics published_statistics;
+	SDL_atomic_t published_statistics_sequence; /* Odd while the copy is being written. */
+	SDL_atomic_t total_underruns; /* Kept separately, as the device callback increments it. */
+	cc_bool starved; /* Only touched by the device callback. */
+	unsigned long reported_underruns;
+} Audio_Stream;
 
 cc_bool Audio_Init(void);
+cc_bool Audio_InitNull(cc_bool resample);
 void Audio_Deinit(void);
+void Audio_SetLatencyBounds(unsigned int minimum_milliseconds, unsigned int maximum_milliseconds);
+cc_bool Audio_SupportsCallbacks(void);
 
 cc_bool Audio_StreamCreate(Audio_Stream *stream, unsigned long sample_rate);
 void Audio_StreamDestroy(Audio_Stream *stream);
 size_t Audio_StreamPushFrames(Audio_Stream *stream, const int16_t *data, size_t frames);
+void Audio_StreamSetLatency(Audio_Stream *stream, unsigned int milliseconds);
+unsigned int Audio_StreamGetLatency(const Audio_Stream *stream);
+void Audio_StreamGetStatistics(Audio_Stream *stream, Audio_Statistics *statistics);
+void Audio_StreamResetStatistics(Audio_Stream *stream);
+void Audio_StreamSetCallback(Audio_Stream *stream, Audio_Callback callback, void *user_data);
+void Audio_StreamSetMinimumLatency(Audio_Stream *stream, unsigned int milliseconds);
+cc_bool Audio_StreamGetBufferStatus(Audio_Stream *stream, unsigned int *occupancy, cc_bool *underrun_likely);
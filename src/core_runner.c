@@ -16,13 +16,35 @@
 #endif
 #include "error.h"
 #include "file.h"
+#include "frame_pacer.h"
 #include "input.h"
+#include "latency_meter.h"
 #include "libretro.h"
+#include "movie.h"
+#include "profiler.h"
+#include "rewind.h"
+#include "ring_buffer.h"
+#include "savestate.h"
 #include "video.h"
 
 #define MIN(a, b) SDL_min(a, b)
 #define MAX(a, b) SDL_max(a, b)
 
+/* How many frames in a row run-ahead may blow the frame budget before it gets turned off. */
+#define RUN_AHEAD_MAX_OVERRUNS 8
+
+/* How much memory to dedicate to rewinding, and how many frames to leave between each savestate. */
+#define REWIND_BUFFER_SIZE (32 * 1024 * 1024)
+#define REWIND_INTERVAL 2
+
+/* How many input snapshots may be queued up for the emulation thread. */
+#define INPUT_QUEUE_LENGTH 16
+
+/* The mailbox's middle slot holds a frame index, plus a flag for whether the emulation thread has put a new frame there. */
+#define TOTAL_MAILBOX_FRAMES 3
+#define MAILBOX_INDEX_MASK 3
+#define MAILBOX_FRESH 4
+
 typedef struct Core
 { 
 	void *handle;
@@ -33,6 +55,21 @@ typedef struct Core
 	cc_bool hardware_render;
 } Core;
 
+typedef struct InputSnapshot
+{
+	Retropad retropad;
+	cc_bool rewind;
+	unsigned int input_sequence; /* For the latency meter. */
+} InputSnapshot;
+
+typedef struct MailboxFrame
+{
+	unsigned char *pixels;
+	size_t capacity;
+	unsigned int width, height;
+	unsigned int input_sequence; /* For the latency meter. */
+} MailboxFrame;
+
 static cc_bool quit;
 
 static cc_bool alternate_layout;
@@ -47,6 +84,11 @@ static char *game_path, *game_path_override;
 /*static char libretro_path[PATH_MAX];*/
 static char *pref_path;
 static char *save_file_path;
+static char *savestate_file_path_prefix;
+static cc_bool savestates_initialised;
+
+static cc_bool movie_recording;
+static cc_bool movie_playing;
 
 static Core core;
 static Variable *variables;
@@ -64,14 +106,87 @@ static size_t core_framebuffer_max_width;
 static size_t core_framebuffer_max_height;
 static float core_framebuffer_display_aspect_ratio;
 static Video_Format core_framebuffer_format;
+static enum retro_pixel_format core_framebuffer_pixel_format;
 static size_t size_of_framebuffer_pixel;
 static cc_bool core_framebuffer_depth;
 static cc_bool core_framebuffer_stencil;
 static cc_bool core_framebuffer_bottom_left_origin;
+static unsigned int core_framebuffer_input_sequence;
+
+/* The framebuffer texture can be handed to the core to render straight into, in which case it stays locked until the frame is uploaded. */
+static cc_bool core_framebuffer_locked;
+static Video_Rect core_framebuffer_lock_rect;
+static unsigned char *core_framebuffer_lock_pixels;
+static size_t core_framebuffer_lock_pitch;
 
 static cc_bool audio_stream_created;
+static SDL_atomic_t audio_statistics_available; /* The main thread's view of 'audio_stream_created'. */
 static Audio_Stream audio_stream;
 static unsigned long audio_stream_sample_rate;
+static char *audio_latency_file_path;
+
+/* Cores which generate audio asynchronously have it pulled from them by SDL's audio thread. */
+static struct retro_audio_callback core_audio_callback;
+static cc_bool audio_callback_active;
+static cc_bool audio_callback_paused;
+static SDL_threadID audio_callback_thread;
+
+/* Cores which do their own frameskipping want to know how full the audio buffer is. */
+static retro_audio_buffer_status_callback_t audio_buffer_status_callback;
+static unsigned int core_minimum_audio_latency;
+
+/* Cores which output one sample at a time have them gathered here, so that they can be resampled in one go. */
+static int16_t audio_staging_buffer[0x800 * 2];
+static size_t audio_staging_frames;
+
+static cc_bool video_enabled = cc_true;
+static cc_bool audio_enabled = cc_true;
+static cc_bool fast_forwarding;
+
+/* Time spent inside of the video and audio callbacks, for benchmarking. */
+static Uint64 video_refresh_time;
+static Uint64 audio_time;
+
+static unsigned int run_ahead_frames;
+static cc_bool run_ahead_preemptive;
+static unsigned char *run_ahead_states;
+static size_t run_ahead_state_size;
+static unsigned long run_ahead_frame_counter;
+static unsigned int run_ahead_overruns;
+static Retropad run_ahead_previous_input;
+
+static cc_bool rewind_enabled;
+static Rewind_State rewind_state;
+static unsigned int rewind_countdown;
+
+/* The input that the core sees, which is latched once per frame. */
+static Retropad core_input;
+static Retropad pending_input;
+static unsigned int core_input_sequence, pending_input_sequence;
+static cc_bool input_latch_pending;
+static double core_frames_per_second;
+
+static cc_bool threaded;
+static SDL_Thread *emulation_thread;
+static SDL_mutex *core_mutex;
+static cc_bool core_paused;
+static SDL_atomic_t emulation_thread_quit;
+static SDL_atomic_t emulation_thread_finished;
+static FramePacer emulation_pacer;
+static cc_bool frameskip_allowed;
+static RingBuffer input_queue;
+static InputSnapshot newest_input;
+
+static MailboxFrame mailbox_frames[TOTAL_MAILBOX_FRAMES];
+static unsigned int mailbox_write_index, mailbox_read_index;
+static unsigned int mailbox_max_width, mailbox_max_height; /* The emulation thread's own copy of the core's maximum frame size. */
+static SDL_atomic_t mailbox_middle;
+
+/* Video changes that the emulation thread made, which the main thread has yet to apply. */
+static SDL_SpinLock pending_video_lock;
+static struct retro_system_av_info pending_video_info;
+static cc_bool pending_geometry;
+static cc_bool pending_system_av_info;
 
 /***************
 * Game loading *
@@ -259,6 +374,76 @@ static void LoadOptions(const struct retro_core_option_definition *options)
 	}
 }
 
+/********
+* Input *
+********/
+
+static void StopMovie(void)
+{
+	Movie_Stop();
+
+	movie_recording = cc_false;
+	movie_playing = cc_false;
+}
+
+/* Gives the core either the real input or the movie's input, recording it if need be. This must be done exactly once per frame. */
+static void LatchInput(const Retropad* const input)
+{
+	if (movie_playing)
+	{
+		if (!Movie_ReadFrame(&core_input))
+		{
+			PrintInfo("Movie playback finished");
+			StopMovie();
+
+			core_input = *input;
+		}
+	}
+	else
+	{
+		core_input = *input;
+
+		if (movie_recording && !Movie_WriteFrame(&core_input))
+		{
+			PrintError("Could not write to the movie file, so recording has been stopped");
+			StopMovie();
+		}
+	}
+}
+
+/* The latency meter's number for the input that the main thread has handed over most recently. */
+static unsigned int GetInputSequence(void)
+{
+	return threaded ? newest_input.input_sequence : LatencyMeter_GetInputSequence();
+}
+
+/* The input is latched as late as possible: when the core polls it, or failing that, when the core first reads it. */
+static void RequestInputLatch(const Retropad* const input)
+{
+	pending_input = *input;
+	pending_input_sequence = GetInputSequence();
+	input_latch_pending = cc_true;
+}
+
+static void LatchPendingInput(void)
+{
+	if (input_latch_pending)
+	{
+		input_latch_pending = cc_false;
+		LatchInput(&pending_input);
+		core_input_sequence = pending_input_sequence;
+	}
+}
+
+/* Only the newest input matters, so skip over any older snapshots that the main thread has queued. */
+static void DrainInputQueue(void)
+{
+	InputSnapshot snapshot;
+
+	while (RingBuffer_Read(&input_queue, &snapshot, 1) != 0)
+		newest_input = snapshot;
+}
+
 /************
 * Callbacks *
 ************/
@@ -301,6 +486,8 @@ static bool SetPixelFormat(const enum retro_pixel_format pixel_format)
 			return false;
 	}
 
+	core_framebuffer_pixel_format = pixel_format;
+
 	return true;
 }
 
@@ -309,6 +496,104 @@ static bool Callback_SetPixelFormat(const enum retro_pixel_format *pixel_format)
 	return SetPixelFormat(*pixel_format);
 }
 
+static void UnlockFramebuffer(void)
+{
+	if (core_framebuffer_locked)
+	{
+		Video_TextureUnlock(Video_FramebufferTexture(&core_framebuffer));
+		core_framebuffer_locked = cc_false;
+	}
+}
+
+/* For when the core did not submit the lock, so its contents must not overwrite the last frame. */
+static void AbandonFramebufferLock(void)
+{
+	if (core_framebuffer_locked)
+	{
+		Video_TextureAbandonLock(Video_FramebufferTexture(&core_framebuffer));
+		core_framebuffer_locked = cc_false;
+	}
+}
+
+static cc_bool LockFramebuffer(const unsigned int width, const unsigned int height)
+{
+	/* A lock of the wrong size is no use, so start again. */
+	if (core_framebuffer_locked && (core_framebuffer_lock_rect.width != width || core_framebuffer_lock_rect.height != height))
+		AbandonFramebufferLock();
+
+	if (!core_framebuffer_locked)
+	{
+		core_framebuffer_lock_rect.x = 0;
+		core_framebuffer_lock_rect.y = 0;
+		core_framebuffer_lock_rect.width = width;
+		core_framebuffer_lock_rect.height = height;
+
+		core_framebuffer_locked = Video_TextureLock(Video_FramebufferTexture(&core_framebuffer), &core_framebuffer_lock_rect, &core_framebuffer_lock_pixels, &core_framebuffer_lock_pitch);
+	}
+
+	return core_framebuffer_locked;
+}
+
+/* Mailbox frames only ever grow, so that there is not an allocation every frame. */
+static cc_bool ReserveMailboxFrame(MailboxFrame* const frame, const size_t size)
+{
+	if (frame->capacity < size)
+	{
+		unsigned char* const pixels = (unsigned char*)SDL_realloc(frame->pixels, size);
+
+		if (pixels != NULL)
+		{
+			frame->pixels = pixels;
+			frame->capacity = size;
+		}
+	}
+
+	return frame->capacity >= size;
+}
+
+static bool Callback_GetCurrentSoftwareFramebuffer(struct retro_framebuffer* const framebuffer)
+{
+	bool success = false;
+
+	/* Frames which are not going to be shown are better off in the core's own memory. */
+	/* Neither of the framebuffers below holds the core's previous frame, so cores which want to read it back cannot have them either. */
+	if (video_enabled && !core.hardware_render && (framebuffer->access_flags & RETRO_MEMORY_ACCESS_READ) == 0)
+	{
+		if (threaded)
+		{
+			/* The emulation thread cannot touch the video layer, so hand out the mailbox frame that is going to be published next instead. */
+			MailboxFrame* const frame = &mailbox_frames[mailbox_write_index];
+
+			if (framebuffer->width <= mailbox_max_width && framebuffer->height <= mailbox_max_height
+			 && ReserveMailboxFrame(frame, mailbox_max_width * mailbox_max_height * size_of_framebuffer_pixel))
+			{
+				framebuffer->data = frame->pixels;
+				framebuffer->pitch = framebuffer->width * size_of_framebuffer_pixel;
+
+				success = true;
+			}
+		}
+		/* If the lock cannot be given back untouched, then a frame that the core does not submit would be shown as garbage. */
+		else if (core_framebuffer_created && Video_TextureCanAbandonLock()
+		 && framebuffer->width <= core_framebuffer_max_width && framebuffer->height <= core_framebuffer_max_height
+		 && LockFramebuffer(framebuffer->width, framebuffer->height))
+		{
+			framebuffer->data = core_framebuffer_lock_pixels;
+			framebuffer->pitch = core_framebuffer_lock_pitch;
+
+			success = true;
+		}
+
+		if (success)
+		{
+			framebuffer->format = core_framebuffer_pixel_format;
+			framebuffer->memory_flags = 0;
+		}
+	}
+
+	return success;
+}
+
 #if defined(RENDERER_OPENGL3) || defined(RENDERER_OPENGLES2)
 static uintptr_t GetCurrentFramebuffer(void)
 {
@@ -503,49 +788,226 @@ static void Callback_GetSaveDirectory(const char **directory)
 	*directory = pref_path;
 }
 
-static void Callback_SetGeometry(const struct retro_game_geometry *geometry)
+static void SetGeometry(const struct retro_game_geometry *geometry)
 {
 	core_framebuffer_display_width = geometry->base_width;
 	core_framebuffer_display_height = geometry->base_height;
 	core_framebuffer_display_aspect_ratio = geometry->aspect_ratio <= 0.0f ? (float)geometry->base_width / (float)geometry->base_height : geometry->aspect_ratio;
 }
 
-static bool SetSystemAVInfo(const struct retro_system_av_info *system_av_info)
+static void Callback_SetGeometry(const struct retro_game_geometry *geometry)
 {
-	*frames_per_second = system_av_info->timing.fps;
+	if (threaded)
+	{
+		/* The video layer belongs to the main thread, so leave this for it to apply. */
+		SDL_AtomicLock(&pending_video_lock);
+		pending_video_info.geometry.base_width = geometry->base_width;
+		pending_video_info.geometry.base_height = geometry->base_height;
+		pending_video_info.geometry.aspect_ratio = geometry->aspect_ratio;
+		pending_geometry = cc_true;
+		SDL_AtomicUnlock(&pending_video_lock);
+	}
+	else
+	{
+		SetGeometry(geometry);
+	}
+}
 
-	Callback_SetGeometry(&system_av_info->geometry);
+/* The latency that the audio stream settled on is remembered for each combination of core and audio driver. */
+static void LoadAudioLatency(void)
+{
+	unsigned char *file_buffer;
+	size_t file_size;
 
-	if (core_framebuffer_max_width != system_av_info->geometry.max_width || core_framebuffer_max_height != system_av_info->geometry.max_height)
+	if (audio_latency_file_path != NULL && ReadFileToAllocatedBuffer(audio_latency_file_path, &file_buffer, &file_size))
 	{
-		if (core_framebuffer_created)
-			Video_FramebufferDestroy(&core_framebuffer);
+		char string[0x10];
+		const size_t length = SDL_min(file_size, sizeof(string) - 1);
 
-		if (core.hardware_render)
-			core_framebuffer_created = Video_FramebufferCreateHardware(&core_framebuffer, system_av_info->geometry.max_width, system_av_info->geometry.max_height, core_framebuffer_depth, core_framebuffer_stencil);
+		/* The file is not NUL-terminated, so it cannot be treated as a string until it has been copied. */
+		SDL_memcpy(string, file_buffer, length);
+		string[length] = '\0';
+		SDL_free(file_buffer);
+
+		Audio_StreamSetLatency(&audio_stream, (unsigned int)SDL_strtoul(string, NULL, 10));
+		PrintDebug("Audio latency target restored to %ums", Audio_StreamGetLatency(&audio_stream));
+	}
+}
+
+static void SaveAudioLatency(void)
+{
+	if (audio_latency_file_path != NULL)
+	{
+		char string[0x10];
+		const int length = SDL_snprintf(string, sizeof(string), "%u\n", Audio_StreamGetLatency(&audio_stream));
+
+		if (!WriteBufferToFile(audio_latency_file_path, string, (size_t)length))
+			PrintError("Audio latency target could not be saved");
+	}
+}
+
+static void FlushAudioStagingBuffer(void)
+{
+	if (audio_staging_frames != 0)
+	{
+		if (audio_stream_created)
+			Audio_StreamPushFrames(&audio_stream, audio_staging_buffer, audio_staging_frames);
+
+		audio_staging_frames = 0;
+	}
+}
+
+/* Cores that use an audio callback may only output audio from within it, as the audio thread is the only one allowed to feed the stream. */
+static cc_bool AudioOutputAllowed(void)
+{
+	if (audio_callback_active)
+		return SDL_ThreadID() == audio_callback_thread;
+	else
+		return audio_stream_created && audio_enabled;
+}
+
+static void AudioCallback(void* const user_data)
+{
+	(void)user_data;
+
+	audio_callback_thread = SDL_ThreadID();
+
+	core_audio_callback.callback();
+
+	FlushAudioStagingBuffer();
+}
+
+/* Must be called with the core paused or from the thread that runs it, whenever anything that decides whether the audio callback should run changes. */
+static void UpdateAudioCallbackState(void)
+{
+	const cc_bool active = core_audio_callback.callback != NULL && audio_stream_created && !audio_callback_paused;
+
+	if (active != audio_callback_active)
+	{
+		/* The core must not be called before it is told that the audio is active, nor after it is told that it is not. */
+		if (active)
+		{
+			if (core_audio_callback.set_state != NULL)
+				core_audio_callback.set_state(true);
+
+			audio_callback_active = cc_true;
+			Audio_StreamSetCallback(&audio_stream, AudioCallback, NULL);
+		}
 		else
-			core_framebuffer_created = Video_FramebufferCreateSoftware(&core_framebuffer, system_av_info->geometry.max_width, system_av_info->geometry.max_height, core_framebuffer_format, cc_true);
+		{
+			Audio_StreamSetCallback(&audio_stream, NULL, NULL);
+			audio_callback_active = cc_false;
 
-		core_framebuffer_max_width = system_av_info->geometry.max_width;
-		core_framebuffer_max_height = system_av_info->geometry.max_height;
+			if (core_audio_callback.set_state != NULL)
+				core_audio_callback.set_state(false);
+		}
+	}
+}
+
+static void ReportAudioBufferStatus(void)
+{
+	if (audio_buffer_status_callback != NULL)
+	{
+		unsigned int occupancy = 0;
+		cc_bool underrun_likely = cc_false;
+
+		/* Frames which have their audio discarded do not affect the buffer, so report it as inactive during them. */
+		const cc_bool active = audio_stream_created && audio_enabled && Audio_StreamGetBufferStatus(&audio_stream, &occupancy, &underrun_likely);
+
+		audio_buffer_status_callback(active, occupancy, underrun_likely);
 	}
+}
+
+/* This half of the AV info belongs to whichever thread is running the core. */
+static void SetSystemTiming(const struct retro_system_av_info *system_av_info)
+{
+	core_frames_per_second = system_av_info->timing.fps;
+
+	if (threaded)
+		FramePacer_SetRate(&emulation_pacer, core_frames_per_second);
 
 	if (audio_stream_sample_rate != system_av_info->timing.sample_rate)
 	{
 		if (audio_stream_created)
+		{
+			SaveAudioLatency();
+
+			SDL_AtomicSet(&audio_statistics_available, 0);
+			audio_stream_created = cc_false;
+			UpdateAudioCallbackState();
+
 			Audio_StreamDestroy(&audio_stream);
+		}
+
+		/* Any staged samples are at the old sample rate, so get rid of them. */
+		audio_staging_frames = 0;
 
 		audio_stream_created = Audio_StreamCreate(&audio_stream, system_av_info->timing.sample_rate);
 
+		if (audio_stream_created)
+		{
+			LoadAudioLatency();
+			Audio_StreamSetMinimumLatency(&audio_stream, core_minimum_audio_latency);
+			UpdateAudioCallbackState();
+			SDL_AtomicSet(&audio_statistics_available, 1);
+		}
+
 		audio_stream_sample_rate = system_av_info->timing.sample_rate;
 	}
+}
+
+/* This half of the AV info belongs to the main thread. */
+static bool SetSystemVideo(const struct retro_system_av_info *system_av_info)
+{
+	*frames_per_second = system_av_info->timing.fps;
+
+	SetGeometry(&system_av_info->geometry);
+
+	if (core_framebuffer_max_width != system_av_info->geometry.max_width || core_framebuffer_max_height != system_av_info->geometry.max_height)
+	{
+		if (core_framebuffer_created)
+		{
+			AbandonFramebufferLock();
+			Video_FramebufferDestroy(&core_framebuffer);
+		}
+
+		if (core.hardware_render)
+			core_framebuffer_created = Video_FramebufferCreateHardware(&core_framebuffer, system_av_info->geometry.max_width, system_av_info->geometry.max_height, core_framebuffer_depth, core_framebuffer_stencil);
+		else
+			core_framebuffer_created = Video_FramebufferCreateSoftware(&core_framebuffer, system_av_info->geometry.max_width, system_av_info->geometry.max_height, core_framebuffer_format, cc_true);
+
+		core_framebuffer_max_width = system_av_info->geometry.max_width;
+		core_framebuffer_max_height = system_av_info->geometry.max_height;
+	}
 
 	return core_framebuffer_created;
 }
 
+static bool SetSystemAVInfo(const struct retro_system_av_info *system_av_info)
+{
+	SetSystemTiming(system_av_info);
+
+	return SetSystemVideo(system_av_info);
+}
+
 static void Callback_SetSystemAVInfo(const struct retro_system_av_info *system_av_info)
 {
-	SetSystemAVInfo(system_av_info);
+	if (threaded)
+	{
+		SetSystemTiming(system_av_info);
+
+		mailbox_max_width = system_av_info->geometry.max_width;
+		mailbox_max_height = system_av_info->geometry.max_height;
+
+		SDL_AtomicLock(&pending_video_lock);
+		pending_video_info = *system_av_info;
+		pending_system_av_info = cc_true;
+		SDL_AtomicUnlock(&pending_video_lock);
+	}
+	else
+	{
+		SetSystemAVInfo(system_av_info);
+	}
 }
 
 static void Callback_GetCoreOptionsVersion(unsigned int *version)
@@ -568,6 +1030,44 @@ static void Callback_GetInputMaxUsers(unsigned int *max_users)
 	*max_users = 1; /* Hardcoded for now */
 }
 
+static void Callback_GetAudioVideoEnable(int *enable)
+{
+	*enable = (video_enabled ? 1 << 0 : 0) | (audio_enabled ? 1 << 1 : 0);
+}
+
+static void Callback_GetFastForwarding(bool *is_fast_forwarding)
+{
+	*is_fast_forwarding = fast_forwarding;
+}
+
+static bool Callback_SetAudioCallback(const struct retro_audio_callback *audio_callback)
+{
+	/* Without a real audio device, the core will have to output its audio the normal way. */
+	if (!Audio_SupportsCallbacks())
+		return false;
+
+	core_audio_callback = *audio_callback;
+
+	/* This is usually called before the audio stream exists, in which case the callback will be started once it does. */
+	UpdateAudioCallbackState();
+
+	return true;
+}
+
+static void Callback_SetAudioBufferStatusCallback(const struct retro_audio_buffer_status_callback *callback)
+{
+	/* Passing NULL disables it. */
+	audio_buffer_status_callback = callback != NULL ? callback->callback : NULL;
+}
+
+static void Callback_SetMinimumAudioLatency(const unsigned int *milliseconds)
+{
+	core_minimum_audio_latency = *milliseconds;
+
+	if (audio_stream_created)
+		Audio_StreamSetMinimumLatency(&audio_stream, core_minimum_audio_latency);
+}
+
 static bool Callback_Environment(unsigned int cmd, void *data)
 {
 	switch (cmd)
@@ -652,6 +1152,34 @@ static bool Callback_Environment(unsigned int cmd, void *data)
 			Callback_GetInputMaxUsers((unsigned int*)data);
 			break;
 
+		case RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE:
+			Callback_GetAudioVideoEnable((int*)data);
+			break;
+
+		case RETRO_ENVIRONMENT_GET_FASTFORWARDING:
+			Callback_GetFastForwarding((bool*)data);
+			break;
+
+		case RETRO_ENVIRONMENT_SET_AUDIO_CALLBACK:
+			if (!Callback_SetAudioCallback((const struct retro_audio_callback*)data))
+				return false;
+
+			break;
+
+		case RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK:
+			Callback_SetAudioBufferStatusCallback((const struct retro_audio_buffer_status_callback*)data);
+			break;
+
+		case RETRO_ENVIRONMENT_SET_MINIMUM_AUDIO_LATENCY:
+			Callback_SetMinimumAudioLatency((const unsigned int*)data);
+			break;
+
+		case RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER:
+			if (!Callback_GetCurrentSoftwareFramebuffer((struct retro_framebuffer*)data))
+				return false;
+
+			break;
+
 		default:
 			return false;
 	}
@@ -659,11 +1187,8 @@ static bool Callback_Environment(unsigned int cmd, void *data)
 	return true;
 }
 
-static void Callback_VideoRefresh(const void *data, unsigned int width, unsigned int height, size_t pitch)
+static void UploadFrame(const void *data, unsigned int width, unsigned int height, size_t pitch)
 {
-	if (data == NULL)
-		return;
-
 	core_framebuffer_display_width = width;
 	core_framebuffer_display_height = height;
 
@@ -672,59 +1197,178 @@ static void Callback_VideoRefresh(const void *data, unsigned int width, unsigned
 
 	if (data != RETRO_HW_FRAME_BUFFER_VALID)
 	{
-		Video_Rect rect;
-		size_t destination_pitch;
-
-		Video_Texture* const texture = Video_FramebufferTexture(&core_framebuffer);
-		const unsigned char *source_pixels = (const unsigned char*)data;
-		unsigned char *destination_pixels;
-
-		rect.x = 0;
-		rect.y = 0;
-		rect.width = width;
-		rect.height = height;
-
-		if (Video_TextureLock(texture, &rect, &destination_pixels, &destination_pitch))
+		/* If the core was handed the framebuffer and rendered into it, then unlocking it is all that is left to do. */
+		if (core_framebuffer_locked && data == core_framebuffer_lock_pixels && width == core_framebuffer_lock_rect.width && height == core_framebuffer_lock_rect.height)
+		{
+			UnlockFramebuffer();
+		}
+		else if (pitch == width * size_of_framebuffer_pixel && LockFramebuffer(width, height))
 		{
+			/* Packed frames, such as the mailbox's, go through the lock, as that can stream them through a pixel buffer. */
+			const unsigned char* const source_pixels = (const unsigned char*)data;
 			unsigned int y;
 
 			for (y = 0; y < height; ++y)
-				SDL_memcpy(&destination_pixels[destination_pitch * y], &source_pixels[pitch * y], width * size_of_framebuffer_pixel);
+				SDL_memcpy(&core_framebuffer_lock_pixels[core_framebuffer_lock_pitch * y], &source_pixels[pitch * y], pitch);
+
+			UnlockFramebuffer();
+		}
+		else
+		{
+			Video_Rect rect;
 
-			Video_TextureUnlock(texture);
+			rect.x = 0;
+			rect.y = 0;
+			rect.width = width;
+			rect.height = height;
+
+			/* The core did not use the lock, so it is only in the way. */
+			AbandonFramebufferLock();
+
+			/* Upload straight from the core's memory, padding and all, rather than repacking the rows. */
+			Video_TextureUpdatePitched(Video_FramebufferTexture(&core_framebuffer), data, &rect, pitch);
 		}
 	}
 }
 
-static size_t Callback_AudioSampleBatch(const int16_t *data, size_t frames)
+/* Used by the emulation thread, which cannot touch the video layer, to hand a copy of the frame over to the main thread. */
+static void PublishFrame(const void *data, unsigned int width, unsigned int height, size_t pitch)
 {
-	if (audio_stream_created)
-		return Audio_StreamPushFrames(&audio_stream, data, frames);
-	else
-		return frames;
-}
+	MailboxFrame* const frame = &mailbox_frames[mailbox_write_index];
+	const size_t row_size = width * size_of_framebuffer_pixel;
 
-static void Callback_AudioSample(int16_t left, int16_t right)
-{
-	if (audio_stream_created)
+	/* A frame that was rendered into the mailbox must not be reallocated from under itself, nor packed into rows that are wider than its own. */
+	if (data == frame->pixels && (pitch < row_size || pitch * height > frame->capacity))
+	{
+		PrintError("The core submitted a framebuffer that does not fit the one that it was given");
+	}
+	else if (!ReserveMailboxFrame(frame, row_size * height))
+	{
+		PrintError("Could not allocate memory for a frame");
+	}
+	else
+	{
+		const unsigned char* const source_pixels = (const unsigned char*)data;
+		unsigned int y;
+
+		if (data != frame->pixels)
+		{
+			for (y = 0; y < height; ++y)
+				SDL_memcpy(&frame->pixels[row_size * y], &source_pixels[pitch * y], row_size);
+		}
+		/* If the core rendered straight into the frame, then there is nothing to copy, unless it used a wider pitch than the rows need. */
+		/* In that case the rows overlap, but packing them in ascending order never overwrites a row before it has been moved. */
+		else if (pitch != row_size)
+		{
+			for (y = 0; y < height; ++y)
+				SDL_memmove(&frame->pixels[row_size * y], &source_pixels[pitch * y], row_size);
+		}
+
+		frame->width = width;
+		frame->height = height;
+		frame->input_sequence = core_input_sequence;
+
+		/* Swap the finished frame into the middle slot, and take whichever frame was there to draw the next one into. */
+		mailbox_write_index = (unsigned int)SDL_AtomicSet(&mailbox_middle, (int)(mailbox_write_index | MAILBOX_FRESH)) & MAILBOX_INDEX_MASK;
+	}
+}
+
+static void VideoRefresh(const void *data, unsigned int width, unsigned int height, size_t pitch)
+{
+	if (data == NULL || !video_enabled)
+		return;
+
+	if (threaded)
+	{
+		PublishFrame(data, width, height, pitch);
+	}
+	else
+	{
+		core_framebuffer_input_sequence = core_input_sequence;
+		UploadFrame(data, width, height, pitch);
+	}
+}
+
+static void Callback_VideoRefresh(const void *data, unsigned int width, unsigned int height, size_t pitch)
+{
+	const Uint64 start_time = SDL_GetPerformanceCounter();
+
+	Profiler_Begin("Callback_VideoRefresh");
+	VideoRefresh(data, width, height, pitch);
+	Profiler_End();
+
+	video_refresh_time += SDL_GetPerformanceCounter() - start_time;
+}
+
+static size_t Callback_AudioSampleBatch(const int16_t *data, size_t frames)
+{
+	const Uint64 start_time = SDL_GetPerformanceCounter();
+
+	if (AudioOutputAllowed())
+	{
+		/* Keep the samples in order, in case the core uses both callbacks. */
+		FlushAudioStagingBuffer();
+		Audio_StreamPushFrames(&audio_stream, data, frames);
+	}
+
+	audio_time += SDL_GetPerformanceCounter() - start_time;
+
+	return frames;
+}
+
+static void Callback_AudioSample(int16_t left, int16_t right)
+{
+	const Uint64 start_time = SDL_GetPerformanceCounter();
+
+	if (AudioOutputAllowed())
 	{
-		int16_t buffer[2];
+		int16_t* const frame = &audio_staging_buffer[audio_staging_frames * 2];
 
-		buffer[0] = left;
-		buffer[1] = right;
-		Audio_StreamPushFrames(&audio_stream, buffer, 1);
+		frame[0] = left;
+		frame[1] = right;
+
+		if (++audio_staging_frames == CC_COUNT_OF(audio_staging_buffer) / 2)
+			FlushAudioStagingBuffer();
 	}
+
+	audio_time += SDL_GetPerformanceCounter() - start_time;
 }
 
 static void Callback_InputPoll(void)
 {
-	/* This function doesn't really suit SDL2 */
+	/* Pick up any input that has arrived since the frame began. Preemptive run-ahead has to know the input before the frame starts, so it latches it early. */
+	if (input_latch_pending)
+	{
+		if (threaded)
+		{
+			/* SDL's events can only be pumped from the main thread, so take whatever it has submitted since then instead. */
+			DrainInputQueue();
+			pending_input = newest_input.retropad;
+		}
+		else
+		{
+			Profiler_Begin("Input_Poll");
+			Input_Poll();
+			Profiler_End();
+
+			pending_input = retropad;
+		}
+
+		pending_input_sequence = GetInputSequence();
+	}
+
+	LatchPendingInput();
 }
 
 static int16_t Callback_InputState(unsigned int port, unsigned int device, unsigned int index, unsigned int id)
 {
 	(void)index;
 
+	/* Some cores never poll. */
+	LatchPendingInput();
+
+	LatencyMeter_InputRead(core_input_sequence);
+
 	if (alternate_layout)
 	{
 		switch (id)
@@ -752,8 +1396,8 @@ static int16_t Callback_InputState(unsigned int port, unsigned int device, unsig
 		switch (device)
 		{
 			case RETRO_DEVICE_JOYPAD:
-				if (id < CC_COUNT_OF(retropad.buttons))
-					return retropad.buttons[id].held;
+				if (id < CC_COUNT_OF(core_input.buttons))
+					return core_input.buttons[id].held;
 
 				break;
 
@@ -761,15 +1405,15 @@ static int16_t Callback_InputState(unsigned int port, unsigned int device, unsig
 				switch (index)
 				{
 					case RETRO_DEVICE_INDEX_ANALOG_BUTTON:
-						if (id < CC_COUNT_OF(retropad.buttons))
-							return retropad.buttons[id].axis;
+						if (id < CC_COUNT_OF(core_input.buttons))
+							return core_input.buttons[id].axis;
 
 						break;
 
 					case RETRO_DEVICE_INDEX_ANALOG_LEFT:
 					case RETRO_DEVICE_INDEX_ANALOG_RIGHT:
-						if (index < CC_COUNT_OF(retropad.sticks) && id < CC_COUNT_OF(retropad.sticks[index].axis))
-							return retropad.sticks[index].axis[id];
+						if (index < CC_COUNT_OF(core_input.sticks) && id < CC_COUNT_OF(core_input.sticks[index].axis))
+							return core_input.sticks[index].axis[id];
 
 						break;
 				}
@@ -781,6 +1425,396 @@ static int16_t Callback_InputState(unsigned int port, unsigned int device, unsig
 	return 0;
 }
 
+static void RunCore(void)
+{
+	Uint64 start_time;
+
+	ReportAudioBufferStatus();
+
+	Profiler_Begin("retro_run");
+	retro_run();
+	Profiler_End();
+
+	LatencyMeter_FrameFinished();
+
+	/* The framebuffer must not be used after 'retro_run' returns, so do not leave it locked if the core never submitted it. */
+	AbandonFramebufferLock();
+
+	/* The input still has to be latched if the core never looked at it, so that movies stay in sync. */
+	LatchPendingInput();
+
+	/* Resample the frame's single samples all at once, rather than one at a time. */
+	/* When the core uses an audio callback, the staging buffer belongs to the audio thread instead. */
+	if (!audio_callback_active)
+	{
+		start_time = SDL_GetPerformanceCounter();
+		FlushAudioStagingBuffer();
+		audio_time += SDL_GetPerformanceCounter() - start_time;
+	}
+}
+
+/************
+* Run-ahead *
+************/
+
+static void RunFrame(const cc_bool video, const cc_bool audio)
+{
+	video_enabled = video;
+	audio_enabled = audio;
+
+	RunCore();
+
+	video_enabled = cc_true;
+	audio_enabled = cc_true;
+}
+
+static cc_bool InputChanged(const Retropad* const a, const Retropad* const b)
+{
+	size_t i;
+
+	for (i = 0; i < CC_COUNT_OF(a->buttons); ++i)
+		if (a->buttons[i].held != b->buttons[i].held || a->buttons[i].axis != b->buttons[i].axis)
+			return cc_true;
+
+	for (i = 0; i < CC_COUNT_OF(a->sticks); ++i)
+		if (a->sticks[i].axis[0] != b->sticks[i].axis[0] || a->sticks[i].axis[1] != b->sticks[i].axis[1])
+			return cc_true;
+
+	return cc_false;
+}
+
+static void DisableRunAhead(void)
+{
+	SDL_free(run_ahead_states);
+	run_ahead_states = NULL;
+	run_ahead_frames = 0;
+}
+
+static cc_bool RunAheadSerialize(const unsigned long frame)
+{
+	unsigned char* const state = &run_ahead_states[run_ahead_state_size * (frame % run_ahead_frames)];
+
+	if (!retro_serialize(state, run_ahead_state_size))
+	{
+		PrintError("Core failed to create a savestate, so run-ahead has been disabled");
+		DisableRunAhead();
+		return cc_false;
+	}
+
+	return cc_true;
+}
+
+static cc_bool RunAheadUnserialize(const unsigned long frame)
+{
+	const unsigned char* const state = &run_ahead_states[run_ahead_state_size * (frame % run_ahead_frames)];
+
+	if (!retro_unserialize(state, run_ahead_state_size))
+	{
+		PrintError("Core failed to load a savestate, so run-ahead has been disabled");
+		DisableRunAhead();
+		return cc_false;
+	}
+
+	return cc_true;
+}
+
+/* Classic run-ahead: advance the real frame, save, run the hidden frames, show the last one, and roll back. */
+static void RunAheadStandard(void)
+{
+	unsigned int i;
+
+	RunFrame(cc_false, cc_true);
+
+	if (!RunAheadSerialize(0))
+		return;
+
+	for (i = 1; i < run_ahead_frames; ++i)
+		RunFrame(cc_false, cc_false);
+
+	RunFrame(cc_true, cc_false);
+
+	RunAheadUnserialize(0);
+}
+
+/* Preemptive frames: keep a savestate for each of the last few frames, and only roll back and
+   re-run them when the input actually changes. Most frames only pay for a single savestate. */
+static void RunAheadPreemptive(void)
+{
+	const unsigned long frame = run_ahead_frame_counter;
+
+	LatchPendingInput();
+
+	if (frame >= run_ahead_frames && InputChanged(&core_input, &run_ahead_previous_input))
+	{
+		/* Replay the last few frames as if the new input had arrived back then. */
+		if (RunAheadUnserialize(frame - run_ahead_frames))
+		{
+			unsigned long i;
+
+			for (i = frame - run_ahead_frames; i < frame; ++i)
+			{
+				if (i != frame - run_ahead_frames && !RunAheadSerialize(i))
+					break;
+
+				RunFrame(cc_false, cc_false);
+			}
+		}
+	}
+
+	/* A failed savestate turns run-ahead off, but the current frame still needs to be run. */
+	if (run_ahead_frames != 0)
+		RunAheadSerialize(frame);
+
+	RunFrame(cc_true, cc_true);
+
+	run_ahead_previous_input = core_input;
+	++run_ahead_frame_counter;
+}
+
+static void RunAhead(void)
+{
+	const Uint64 start_time = SDL_GetPerformanceCounter();
+
+	/* Preemptive frames rewrite frames which have already been recorded, so movies only get standard run-ahead. */
+	/* That also keeps the frame counter at zero, so rollbacks cannot reach back past the movie's start. */
+	if (run_ahead_preemptive && !movie_recording && !movie_playing)
+		RunAheadPreemptive();
+	else
+		RunAheadStandard();
+
+	/* If the extra frames and savestates no longer fit in a frame, then run-ahead is doing more harm than good. */
+	if (run_ahead_frames != 0)
+	{
+		if (SDL_GetPerformanceCounter() - start_time <= SDL_GetPerformanceFrequency() / core_frames_per_second)
+		{
+			run_ahead_overruns = 0;
+		}
+		else if (++run_ahead_overruns == RUN_AHEAD_MAX_OVERRUNS)
+		{
+			PrintWarning("Run-ahead does not fit within the frame budget, so it has been disabled");
+			DisableRunAhead();
+		}
+	}
+}
+
+/************
+* Rewinding *
+************/
+
+static void DisableRewind(void)
+{
+	if (rewind_enabled)
+		Rewind_Destroy(&rewind_state);
+
+	rewind_enabled = cc_false;
+}
+
+static void CaptureRewindState(void)
+{
+	if (--rewind_countdown == 0)
+	{
+		rewind_countdown = REWIND_INTERVAL;
+
+		if (retro_serialize(Rewind_GetCaptureBuffer(&rewind_state), rewind_state.state_size))
+			Rewind_Push(&rewind_state);
+	}
+}
+
+/*********
+* Movies *
+*********/
+
+static Uint64 HashGame(void)
+{
+	Uint64 hash = 0;
+
+	if (game_buffer != NULL)
+	{
+		hash = Movie_Hash(game_buffer, game_buffer_size);
+	}
+	else
+	{
+		/* The core loaded the game by itself, so read it from the file instead. */
+		MappedFile file;
+
+		if (MapFile(game_path_override != NULL ? game_path_override : game_path, &file))
+		{
+			hash = Movie_Hash(file.data, file.size);
+			UnmapFile(&file);
+		}
+	}
+
+	return hash;
+}
+
+static const char* GetCorePath(void)
+{
+#ifdef DYNAMIC_CORE
+	return core_path;
+#else
+	return "";
+#endif
+}
+
+static void Update(void)
+{
+	if (run_ahead_frames != 0 && !fast_forwarding)
+		RunAhead();
+	else
+		RunCore();
+
+	if (rewind_enabled)
+		CaptureRewindState();
+}
+
+static void SkipFrame(const Retropad* const input, const cc_bool audio)
+{
+	RequestInputLatch(input);
+
+	RunFrame(cc_false, audio);
+
+	if (rewind_enabled)
+		CaptureRewindState();
+
+	/* This frame did not get a run-ahead savestate, so the old ones cannot be rolled back to. */
+	run_ahead_frame_counter = 0;
+}
+
+static void Rewind(void)
+{
+	if (rewind_enabled)
+	{
+		const unsigned char* const state = Rewind_Pop(&rewind_state);
+
+		if (state != NULL && retro_unserialize(state, rewind_state.state_size))
+		{
+			/* Run a frame so that there is something to show. */
+			RunFrame(cc_true, cc_false);
+
+			/* The savestates that run-ahead made are from the future now, so they must not be rolled back to. */
+			run_ahead_frame_counter = 0;
+		}
+	}
+}
+
+/*******************
+* Emulation thread *
+*******************/
+
+static void LockCore(void)
+{
+	if (threaded)
+		SDL_LockMutex(core_mutex);
+}
+
+static void UnlockCore(void)
+{
+	if (threaded)
+		SDL_UnlockMutex(core_mutex);
+}
+
+static int EmulationThread(void *user_data)
+{
+	unsigned int frames_to_skip = 0;
+
+	(void)user_data;
+
+	Profiler_NameThread("Emulation");
+
+	while (!SDL_AtomicGet(&emulation_thread_quit))
+	{
+		cc_bool skip_pacing;
+
+		DrainInputQueue();
+
+		SDL_LockMutex(core_mutex);
+
+		/* Rewinding would desynchronise a movie, so carry on as normal instead. */
+		if (newest_input.rewind && !movie_recording && !movie_playing)
+		{
+			core_input = newest_input.retropad;
+			Rewind();
+		}
+		else if (fast_forwarding && (SDL_AtomicGet(&mailbox_middle) & MAILBOX_FRESH) != 0)
+		{
+			/* The main thread has not shown the last frame yet, so this one would never be seen.
+			   Like the single-threaded loop, only show one frame per present, and run the rest without video or audio. */
+			SkipFrame(&newest_input.retropad, cc_false);
+		}
+		else
+		{
+			/* Catch up on the frames that the pacer says that we fell behind on, without showing them. */
+			for (; frames_to_skip != 0 && !quit; --frames_to_skip)
+				SkipFrame(&newest_input.retropad, cc_true);
+
+			RequestInputLatch(&newest_input.retropad);
+			Update();
+		}
+
+		frames_to_skip = 0;
+		skip_pacing = fast_forwarding;
+
+		SDL_UnlockMutex(core_mutex);
+
+		if (quit)
+		{
+			SDL_AtomicSet(&emulation_thread_finished, 1);
+			break;
+		}
+
+		Profiler_Begin("Pacing");
+
+		if (skip_pacing)
+			FramePacer_Reset(&emulation_pacer);
+		else
+			frames_to_skip = FramePacer_Wait(&emulation_pacer);
+
+		Profiler_End();
+	}
+
+	return 0;
+}
+
+static void ApplyPendingVideoChanges(void)
+{
+	struct retro_system_av_info system_av_info;
+	cc_bool geometry, av_info;
+
+	SDL_AtomicLock(&pending_video_lock);
+	system_av_info = pending_video_info;
+	geometry = pending_geometry;
+	av_info = pending_system_av_info;
+	pending_geometry = cc_false;
+	pending_system_av_info = cc_false;
+	SDL_AtomicUnlock(&pending_video_lock);
+
+	if (av_info)
+		SetSystemVideo(&system_av_info);
+	else if (geometry)
+		SetGeometry(&system_av_info.geometry);
+}
+
+static void ReceiveFrame(void)
+{
+	if (SDL_AtomicGet(&mailbox_middle) & MAILBOX_FRESH)
+	{
+		const MailboxFrame *frame;
+
+		mailbox_read_index = (unsigned int)SDL_AtomicSet(&mailbox_middle, (int)mailbox_read_index) & MAILBOX_INDEX_MASK;
+		frame = &mailbox_frames[mailbox_read_index];
+		core_framebuffer_input_sequence = frame->input_sequence;
+
+		/* This must come after taking the frame, as the frame may depend on changes that were made before it was published. */
+		ApplyPendingVideoChanges();
+
+		UploadFrame(frame->pixels, MIN(frame->width, core_framebuffer_max_width), MIN(frame->height, core_framebuffer_max_height), frame->width * size_of_framebuffer_pixel);
+	}
+	else
+	{
+		ApplyPendingVideoChanges();
+	}
+}
+
 /*******
 * Main *
 *******/
@@ -826,6 +1860,7 @@ cc_bool CoreRunner_Init(
 		forward_slash != NULL ? forward_slash + 1 : game_path;
 
 	SDL_asprintf(&save_file_path, "%s/%s.sav", pref_path, game_filename);
+	SDL_asprintf(&savestate_file_path_prefix, "%s/%s.state", pref_path, game_filename);
 
 #ifdef DYNAMIC_CORE
 	/* Load the core, set some callbacks, and initialise it */
@@ -842,6 +1877,15 @@ cc_bool CoreRunner_Init(
 		}
 		else
 		{
+			struct retro_system_info system_info;
+			const char* const audio_driver = SDL_GetCurrentAudioDriver();
+
+			retro_get_system_info(&system_info);
+
+			/* There is no point in remembering the latency of the null output, as it is never tuned. */
+			if (audio_driver != NULL)
+				SDL_asprintf(&audio_latency_file_path, "%s/%s (%s).latency", pref_path, system_info.library_name, audio_driver);
+
 			/* Set default pixel format */
 			SetPixelFormat(RETRO_PIXEL_FORMAT_0RGB1555);
 
@@ -892,6 +1936,9 @@ cc_bool CoreRunner_Init(
 							PrintError("Save file could not be read");
 					}
 
+					/* Some cores do not know their savestate size until they have run a frame, but that is fine: the buffers will just be enlarged later. */
+					savestates_initialised = SaveState_Init(retro_serialize_size());
+
 					if (core.hardware_render)
 						core.context_reset();
 
@@ -934,6 +1981,8 @@ cc_bool CoreRunner_Init(
 #endif
 	SDL_free(pref_path);
 	SDL_free(save_file_path);
+	SDL_free(savestate_file_path_prefix);
+	SDL_free(audio_latency_file_path);
 
 	return cc_false;
 }
@@ -941,9 +1990,23 @@ cc_bool CoreRunner_Init(
 void CoreRunner_Deinit(void)
 {
 	size_t i;
+	void *save_ram;
+	size_t save_ram_size;
+
+	/* The core cannot be shut down while it is still running on another thread. */
+	CoreRunner_StopThread();
+
+	audio_callback_paused = cc_true;
+	UpdateAudioCallbackState();
+
+	StopMovie();
 
-	void* const save_ram = retro_get_memory_data(RETRO_MEMORY_SAVE_RAM);
-	const size_t save_ram_size = retro_get_memory_size(RETRO_MEMORY_SAVE_RAM);
+	/* This waits for any savestates that are still being written. */
+	if (savestates_initialised)
+		SaveState_Deinit();
+
+	save_ram = retro_get_memory_data(RETRO_MEMORY_SAVE_RAM);
+	save_ram_size = retro_get_memory_size(RETRO_MEMORY_SAVE_RAM);
 
 	if (save_ram != NULL && save_ram_size != 0)
 	{
@@ -966,7 +2029,12 @@ void CoreRunner_Deinit(void)
 #endif
 
 	if (audio_stream_created)
+	{
+		SaveAudioLatency();
+		SDL_AtomicSet(&audio_statistics_available, 0);
+		audio_stream_created = cc_false;
 		Audio_StreamDestroy(&audio_stream);
+	}
 
 	Video_FramebufferDestroy(&core_framebuffer);
 
@@ -975,6 +2043,11 @@ void CoreRunner_Deinit(void)
 #endif
 	SDL_free(pref_path);
 	SDL_free(save_file_path);
+	SDL_free(savestate_file_path_prefix);
+	SDL_free(audio_latency_file_path);
+
+	DisableRunAhead();
+	DisableRewind();
 
 	for (i = 0; i < total_variables; ++i)
 	{
@@ -996,22 +2069,176 @@ void CoreRunner_Deinit(void)
 
 cc_bool CoreRunner_Update(void)
 {
+	RequestInputLatch(&retropad);
+
 	/* Update the core */
-	retro_run();
+	Update();
+
+	return !quit;
+}
+
+cc_bool CoreRunner_SkipFrame(const cc_bool audio)
+{
+	SkipFrame(&retropad, audio);
 
 	return !quit;
 }
 
+cc_bool CoreRunner_Rewind(void)
+{
+	/* Rewinding would desynchronise a movie, so carry on as normal instead. */
+	if (movie_recording || movie_playing)
+	{
+		RequestInputLatch(&retropad);
+		Update();
+	}
+	else
+	{
+		core_input = retropad;
+		Rewind();
+	}
+
+	return !quit;
+}
+
+cc_bool CoreRunner_StartThread(void)
+{
+	if (core.hardware_render)
+	{
+		PrintInfo("Hardware-rendered cores cannot run on their own thread");
+	}
+	else
+	{
+		core_mutex = SDL_CreateMutex();
+
+		if (core_mutex == NULL)
+		{
+			PrintError("SDL_CreateMutex failed - Error: '%s'", SDL_GetError());
+		}
+		else
+		{
+			if (!RingBuffer_Create(&input_queue, sizeof(InputSnapshot), INPUT_QUEUE_LENGTH))
+			{
+				PrintError("Could not allocate memory for the input queue");
+			}
+			else
+			{
+				mailbox_write_index = 0;
+				mailbox_max_width = core_framebuffer_max_width;
+				mailbox_max_height = core_framebuffer_max_height;
+				SDL_AtomicSet(&mailbox_middle, 1);
+				mailbox_read_index = 2;
+
+				SDL_AtomicSet(&emulation_thread_quit, 0);
+				SDL_AtomicSet(&emulation_thread_finished, 0);
+				FramePacer_Init(&emulation_pacer, core_frames_per_second);
+				FramePacer_SetFrameskip(&emulation_pacer, frameskip_allowed);
+
+				core_input = retropad;
+				newest_input.retropad = retropad;
+				newest_input.rewind = cc_false;
+				newest_input.input_sequence = LatencyMeter_GetInputSequence();
+				core_paused = cc_false;
+				threaded = cc_true;
+
+				emulation_thread = SDL_CreateThread(EmulationThread, "Emulation", NULL);
+
+				if (emulation_thread != NULL)
+					return cc_true;
+
+				PrintError("SDL_CreateThread failed - Error: '%s'", SDL_GetError());
+
+				threaded = cc_false;
+
+				RingBuffer_Destroy(&input_queue);
+			}
+
+			SDL_DestroyMutex(core_mutex);
+		}
+	}
+
+	return cc_false;
+}
+
+void CoreRunner_StopThread(void)
+{
+	if (threaded)
+	{
+		size_t i;
+
+		SDL_AtomicSet(&emulation_thread_quit, 1);
+
+		if (core_paused)
+			SDL_UnlockMutex(core_mutex);
+
+		SDL_WaitThread(emulation_thread, NULL);
+
+		threaded = cc_false;
+
+		/* Catch up on anything that the thread left behind. */
+		ApplyPendingVideoChanges();
+
+		RingBuffer_Destroy(&input_queue);
+		SDL_DestroyMutex(core_mutex);
+
+		for (i = 0; i < CC_COUNT_OF(mailbox_frames); ++i)
+		{
+			SDL_free(mailbox_frames[i].pixels);
+			mailbox_frames[i].pixels = NULL;
+			mailbox_frames[i].capacity = 0;
+		}
+	}
+}
+
+cc_bool CoreRunner_SubmitInput(const Retropad* const input, const cc_bool rewind)
+{
+	InputSnapshot snapshot;
+
+	snapshot.retropad = *input;
+	snapshot.rewind = rewind;
+	snapshot.input_sequence = LatencyMeter_GetInputSequence();
+
+	/* If the queue is full, then the emulation thread is stalled, and it will get the next snapshot instead. */
+	RingBuffer_Write(&input_queue, &snapshot, 1);
+
+	return !SDL_AtomicGet(&emulation_thread_finished);
+}
+
+void CoreRunner_SetPaused(const cc_bool paused)
+{
+	/* Holding the core's mutex stops the emulation thread from running any more frames. */
+	if (threaded && paused && !core_paused)
+	{
+		SDL_LockMutex(core_mutex);
+		core_paused = cc_true;
+	}
+
+	/* The audio thread must not call into the core while it is paused either. */
+	audio_callback_paused = paused;
+	UpdateAudioCallbackState();
+
+	if (threaded && !paused && core_paused)
+	{
+		SDL_UnlockMutex(core_mutex);
+		core_paused = cc_false;
+	}
+}
+
 void CoreRunner_Draw(void)
 {
 	size_t dst_width;
 	size_t dst_height;
 	Video_Rect src_rect;
 	Video_Rect dst_rect;
+	size_t upscale_factor;
 
-	const size_t upscale_factor = MAX(1, MIN(window_width / core_framebuffer_display_width, window_height / core_framebuffer_display_height));
 	const Video_Colour white = {0xFF, 0xFF, 0xFF};
 
+	if (threaded)
+		ReceiveFrame();
+
+	upscale_factor = MAX(1, MIN(window_width / core_framebuffer_display_width, window_height / core_framebuffer_display_height));
+
 	if (screen_type == CORE_RUNNER_SCREEN_TYPE_PIXEL_PERFECT || screen_type == CORE_RUNNER_SCREEN_TYPE_PIXEL_PERFECT_WITH_SCANLINES)
 	{
 		dst_width = core_framebuffer_display_width * upscale_factor;
@@ -1056,6 +2283,8 @@ void CoreRunner_Draw(void)
 		for (i = 0; i < core_framebuffer_display_height; ++i)
 			Video_DrawLine(dst_rect.x, dst_rect.y + i * upscale_factor, dst_rect.x + dst_rect.width, dst_rect.y + i * upscale_factor);
 	}
+
+	LatencyMeter_FrameDrawn(core_framebuffer_input_sequence);
 }
 
 void CoreRunner_GetVariables(Variable **variables_pointer, size_t *total_variables_pointer)
@@ -1071,10 +2300,290 @@ void CoreRunner_VariablesModified(void)
 
 void CoreRunner_SetAlternateButtonLayout(cc_bool enable)
 {
+	LockCore();
 	alternate_layout = enable;
+	UnlockCore();
 }
 
 void CoreRunner_SetScreenType(CoreRunnerScreenType _screen_type)
 {
 	screen_type = _screen_type;
 }
+
+static cc_bool SetRunAhead(const unsigned int frames, const cc_bool preemptive)
+{
+	DisableRunAhead();
+
+	if (frames == 0)
+		return cc_true;
+
+	run_ahead_state_size = retro_serialize_size();
+
+	if (run_ahead_state_size == 0)
+	{
+		PrintError("Core does not support savestates, so run-ahead cannot be used");
+		return cc_false;
+	}
+
+	/* Standard run-ahead only ever needs the one savestate. */
+	run_ahead_states = (unsigned char*)SDL_malloc(run_ahead_state_size * (preemptive ? frames : 1));
+
+	if (run_ahead_states == NULL)
+	{
+		PrintError("Could not allocate memory for the run-ahead savestates");
+		return cc_false;
+	}
+
+	run_ahead_frames = frames;
+	run_ahead_preemptive = preemptive;
+	run_ahead_frame_counter = 0;
+	run_ahead_overruns = 0;
+
+	return cc_true;
+}
+
+cc_bool CoreRunner_SetRunAhead(const unsigned int frames, const cc_bool preemptive)
+{
+	cc_bool success;
+
+	LockCore();
+	success = SetRunAhead(frames, preemptive);
+	UnlockCore();
+
+	return success;
+}
+
+unsigned int CoreRunner_GetRunAhead(void)
+{
+	unsigned int frames;
+
+	LockCore();
+	frames = run_ahead_frames;
+	UnlockCore();
+
+	return frames;
+}
+
+static cc_bool SetRewind(const cc_bool enabled)
+{
+	DisableRewind();
+
+	if (!enabled)
+		return cc_true;
+
+	if (retro_serialize_size() == 0)
+	{
+		PrintError("Core does not support savestates, so rewinding cannot be used");
+		return cc_false;
+	}
+
+	if (!Rewind_Create(&rewind_state, retro_serialize_size(), REWIND_BUFFER_SIZE))
+	{
+		PrintError("Could not create the rewind buffer");
+		return cc_false;
+	}
+
+	rewind_enabled = cc_true;
+	rewind_countdown = 1;
+
+	return cc_true;
+}
+
+cc_bool CoreRunner_SetRewind(const cc_bool enabled)
+{
+	cc_bool success;
+
+	LockCore();
+	success = SetRewind(enabled);
+	UnlockCore();
+
+	return success;
+}
+
+cc_bool CoreRunner_SaveState(const unsigned int slot)
+{
+	cc_bool success = cc_false;
+	size_t state_size;
+
+	LockCore();
+
+	state_size = retro_serialize_size();
+
+	if (!savestates_initialised || state_size == 0)
+	{
+		PrintError("Core does not support savestates");
+	}
+	else
+	{
+		/* The core serialises straight into a buffer that the worker thread will compress and write out, so this is the only copy that is made here. */
+		unsigned char* const state = SaveState_BeginSave(state_size);
+
+		if (state == NULL)
+		{
+			PrintWarning("The previous savestates are still being written");
+		}
+		else if (!retro_serialize(state, state_size))
+		{
+			PrintError("Core failed to create a savestate");
+		}
+		else
+		{
+			char *file_path;
+
+			if (SDL_asprintf(&file_path, "%s%u", savestate_file_path_prefix, slot) != -1)
+			{
+				SaveState_EndSave(file_path, state_size);
+				SDL_free(file_path);
+
+				success = cc_true;
+			}
+		}
+	}
+
+	UnlockCore();
+
+	return success;
+}
+
+cc_bool CoreRunner_LoadState(const unsigned int slot)
+{
+	cc_bool success = cc_false;
+	char *file_path;
+
+	if (SDL_asprintf(&file_path, "%s%u", savestate_file_path_prefix, slot) != -1)
+	{
+		const unsigned char *state;
+		size_t state_size;
+
+		LockCore();
+
+		state = movie_recording || movie_playing ? NULL : SaveState_BeginLoad(file_path, &state_size);
+
+		if (state != NULL)
+		{
+			if (!retro_unserialize(state, state_size))
+			{
+				PrintError("Core failed to load savestate");
+			}
+			else
+			{
+				/* The run-ahead savestates are from a different timeline now. */
+				run_ahead_frame_counter = 0;
+
+				success = cc_true;
+			}
+
+			SaveState_EndLoad();
+		}
+
+		UnlockCore();
+
+		SDL_free(file_path);
+	}
+
+	return success;
+}
+
+cc_bool CoreRunner_RecordMovie(const char* const file_path)
+{
+	cc_bool success = cc_false;
+
+	/* Movies begin with a savestate, so that they do not depend on how far the game had gotten before recording. */
+	const size_t state_size = retro_serialize_size();
+	unsigned char* const state = state_size == 0 ? NULL : (unsigned char*)SDL_malloc(state_size);
+
+	if (state_size != 0 && (state == NULL || !retro_serialize(state, state_size)))
+	{
+		PrintError("Could not create the movie's savestate");
+	}
+	else
+	{
+		if (state_size == 0)
+			PrintWarning("Core does not support savestates, so the movie will only play back correctly from boot");
+
+		StopMovie();
+		movie_recording = Movie_StartRecording(file_path, HashGame(), GetCorePath(), state, state_size);
+		success = movie_recording;
+
+		/* Nothing from before the movie should leak into it. */
+		run_ahead_frame_counter = 0;
+	}
+
+	SDL_free(state);
+
+	return success;
+}
+
+cc_bool CoreRunner_PlayMovie(const char* const file_path)
+{
+	cc_bool success = cc_false;
+	unsigned char *state;
+	size_t state_size;
+
+	StopMovie();
+
+	if (Movie_StartPlayback(file_path, HashGame(), GetCorePath(), &state, &state_size))
+	{
+		if (state != NULL && !retro_unserialize(state, state_size))
+		{
+			PrintError("Core failed to load the movie's savestate");
+			Movie_Stop();
+		}
+		else
+		{
+			/* Nothing from before the movie should leak into it. */
+			run_ahead_frame_counter = 0;
+
+			movie_playing = cc_true;
+			success = cc_true;
+		}
+
+		SDL_free(state);
+	}
+
+	return success;
+}
+
+cc_bool CoreRunner_IsPlayingMovie(void)
+{
+	return movie_playing;
+}
+
+void CoreRunner_GetCallbackTimes(double* const video_refresh_seconds, double* const audio_seconds)
+{
+	const double frequency = (double)SDL_GetPerformanceFrequency();
+
+	*video_refresh_seconds = video_refresh_time / frequency;
+	*audio_seconds = audio_time / frequency;
+}
+
+/* This is called while drawing every frame, so it must not wait for the emulation thread. The stream publishes its statistics for this. */
+/* The emulation thread may still recreate the stream while they are being read, but the published copy is only ever written under its sequence number, so the read just retries. */
+cc_bool CoreRunner_GetAudioStatistics(Audio_Statistics* const statistics)
+{
+	const cc_bool available = SDL_AtomicGet(&audio_statistics_available) != 0;
+
+	if (available)
+		Audio_StreamGetStatistics(&audio_stream, statistics);
+
+	return available;
+}
+
+void CoreRunner_SetFrameskip(const cc_bool allowed)
+{
+	LockCore();
+
+	frameskip_allowed = allowed;
+
+	if (threaded)
+		FramePacer_SetFrameskip(&emulation_pacer, allowed);
+
+	UnlockCore();
+}
+
+void CoreRunner_SetFastForwarding(const cc_bool enabled)
+{
+	LockCore();
+	fast_forwarding = enabled;
+	UnlockCore();
+}
@@ -4,6 +4,9 @@
 
 #include "clowncommon/clowncommon.h"
 
+#include "audio.h"
+#include "input.h"
+
 typedef struct Variable
 {
 	char *key;
@@ -32,8 +35,26 @@ cc_bool CoreRunner_Init(
 	const char *_game_path, double *_frames_per_second);
 void CoreRunner_Deinit(void);
 cc_bool CoreRunner_Update(void);
+cc_bool CoreRunner_SkipFrame(cc_bool audio);
+cc_bool CoreRunner_Rewind(void);
+cc_bool CoreRunner_StartThread(void);
+void CoreRunner_StopThread(void);
+cc_bool CoreRunner_SubmitInput(const Retropad *input, cc_bool rewind);
+void CoreRunner_SetPaused(cc_bool paused);
 void CoreRunner_Draw(void);
 void CoreRunner_GetVariables(Variable **variables_pointer, size_t *total_variables_pointer);
 void CoreRunner_VariablesModified(void);
 void CoreRunner_SetAlternateButtonLayout(cc_bool enable);
 void CoreRunner_SetScreenType(CoreRunnerScreenType _screen_type);
+cc_bool CoreRunner_SetRunAhead(unsigned int frames, cc_bool preemptive);
+unsigned int CoreRunner_GetRunAhead(void);
+cc_bool CoreRunner_SetRewind(cc_bool enabled);
+cc_bool CoreRunner_SaveState(unsigned int slot);
+cc_bool CoreRunner_LoadState(unsigned int slot);
+cc_bool CoreRunner_RecordMovie(const char *file_path);
+cc_bool CoreRunner_PlayMovie(const char *file_path);
+cc_bool CoreRunner_IsPlayingMovie(void);
+void CoreRunner_SetFrameskip(cc_bool allowed);
+void CoreRunner_SetFastForwarding(cc_bool enabled);
+void CoreRunner_GetCallbackTimes(double *video_refresh_seconds, double *audio_seconds);
+cc_bool CoreRunner_GetAudioStatistics(Audio_Statistics *statistics);
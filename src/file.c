@@ -2,6 +2,18 @@
 
 #include <stddef.h>
 
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#define FILE_MAPPING_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#define FILE_MAPPING_POSIX
+#endif
+
 #include "SDL.h"
 
 cc_bool ReadFileToAllocatedBuffer(const char* const filename, unsigned char** const buffer, size_t* const size)
@@ -59,3 +71,88 @@ cc_bool ReadFileToBuffer(const char* const filename, void* const buffer, const s
 
 	return success;
 }
+
+/* Maps a file into memory for reading, so that its contents can be used without copying them into a buffer first. */
+cc_bool MapFile(const char* const filename, MappedFile* const mapped_file)
+{
+	cc_bool success = cc_false;
+
+#if defined(FILE_MAPPING_WIN32)
+	const HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER file_size;
+
+		if (GetFileSizeEx(file, &file_size) && file_size.QuadPart != 0)
+		{
+			const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+			if (mapping != NULL)
+			{
+				/* The view keeps the mapping alive, so the handles are not needed after this. */
+				mapped_file->data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				mapped_file->size = (size_t)file_size.QuadPart;
+				mapped_file->mapped = cc_true;
+
+				success = mapped_file->data != NULL;
+
+				CloseHandle(mapping);
+			}
+		}
+
+		CloseHandle(file);
+	}
+#elif defined(FILE_MAPPING_POSIX)
+	const int file = open(filename, O_RDONLY);
+
+	if (file != -1)
+	{
+		struct stat file_status;
+
+		if (fstat(file, &file_status) == 0 && file_status.st_size != 0)
+		{
+			void* const data = mmap(NULL, (size_t)file_status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+			if (data != MAP_FAILED)
+			{
+				mapped_file->data = (const unsigned char*)data;
+				mapped_file->size = (size_t)file_status.st_size;
+				mapped_file->mapped = cc_true;
+
+				success = cc_true;
+			}
+		}
+
+		close(file);
+	}
+#else
+	unsigned char *buffer;
+
+	if (ReadFileToAllocatedBuffer(filename, &buffer, &mapped_file->size))
+	{
+		mapped_file->data = buffer;
+		mapped_file->mapped = cc_false;
+
+		success = cc_true;
+	}
+#endif
+
+	return success;
+}
+
+void UnmapFile(MappedFile* const mapped_file)
+{
+	if (!mapped_file->mapped)
+	{
+		SDL_free((void*)mapped_file->data);
+	}
+	else
+	{
+#if defined(FILE_MAPPING_WIN32)
+		UnmapViewOfFile(mapped_file->data);
+#elif defined(FILE_MAPPING_POSIX)
+		munmap((void*)mapped_file->data, mapped_file->size);
+#endif
+	}
+}
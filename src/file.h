@@ -4,6 +4,15 @@
 
 #include "clowncommon/clowncommon.h"
 
+typedef struct MappedFile
+{
+	const unsigned char *data;
+	size_t size;
+	cc_bool mapped; /* Platforms without memory-mapping just read the whole file into memory instead. */
+} MappedFile;
+
 cc_bool ReadFileToAllocatedBuffer(const char *filename, unsigned char **buffer, size_t *size);
 cc_bool WriteBufferToFile(const char *filename, const void *buffer, size_t size);
 cc_bool ReadFileToBuffer(const char* const filename, void* const buffer, const size_t size);
+cc_bool MapFile(const char *filename, MappedFile *mapped_file);
+void UnmapFile(MappedFile *mapped_file);
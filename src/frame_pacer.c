@@ -0,0 +1,343 @@
+#include "frame_pacer.h"
+
+#include "SDL.h"
+
+/* SDL_Delay can wake up anywhere from a fraction of a millisecond to a whole timer tick late, so how late it is gets measured.
+   Sleeping stops that long before the deadline, and never less than this, and the rest is spun. */
+#define MINIMUM_SPIN_MICROSECONDS 500
+#define MICROSECONDS_PER_MILLISECOND 1000
+
+/* How many sleeps to time when the pacer is created, and how quickly the measurement falls back after the OS oversleeps as a one-off. */
+#define SLEEP_CALIBRATION_SAMPLES 4
+#define SLEEP_GRANULARITY_DECAY 16
+
+/* Frameskipping starts after this many frames in a row are over a frame late, and stops after this many frames in a row have time to spare. */
+#define FRAMESKIP_START_FRAMES 3
+#define FRAMESKIP_STOP_FRAMES 60
+
+/* A frame has time to spare if it finishes this far ahead of its deadline. */
+#define FRAMESKIP_SPARE_TIME 0.25
+
+/* Falling further behind than this is treated as a stall, rather than something to catch up from. */
+#define MAX_FRAMESKIP 4
+
+/* The frame delay leaves this much time spare on top of the 99th percentile of frames' running times, and is recalculated this often. */
+#define FRAME_DELAY_MARGIN_MICROSECONDS 1000
+#define FRAME_DELAY_UPDATE_FRAMES 30
+
+static Uint64 MicrosecondsToTicks(const FramePacer* const pacer, const Uint64 microseconds)
+{
+	return pacer->frequency * microseconds / 1000000;
+}
+
+static void AdvanceTarget(FramePacer* const pacer)
+{
+	const double whole_ticks = SDL_floor(pacer->target_fraction + pacer->period);
+
+	pacer->target += (Uint64)whole_ticks;
+	pacer->target_fraction += pacer->period - whole_ticks;
+}
+
+static void Resynchronise(FramePacer* const pacer, const Uint64 now)
+{
+	pacer->target = now;
+	pacer->target_fraction = 0.0;
+}
+
+static void UpdateFrameskip(FramePacer* const pacer, const double lateness)
+{
+	if (lateness >= pacer->period)
+	{
+		pacer->comfortable_frames = 0;
+
+		if (++pacer->struggling_frames >= FRAMESKIP_START_FRAMES)
+			pacer->frameskipping = pacer->frameskip_allowed;
+	}
+	else if (lateness <= -pacer->period * FRAMESKIP_SPARE_TIME)
+	{
+		pacer->struggling_frames = 0;
+
+		if (++pacer->comfortable_frames >= FRAMESKIP_STOP_FRAMES)
+			pacer->frameskipping = cc_false;
+	}
+}
+
+/* Sleeps and returns how many ticks later than asked it woke up. */
+static Uint64 TimedDelay(FramePacer* const pacer, const Uint32 milliseconds)
+{
+	const Uint64 requested_ticks = MicrosecondsToTicks(pacer, (Uint64)milliseconds * MICROSECONDS_PER_MILLISECOND);
+	const Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 elapsed_ticks;
+
+	SDL_Delay(milliseconds);
+
+	elapsed_ticks = SDL_GetPerformanceCounter() - start;
+
+	return elapsed_ticks > requested_ticks ? elapsed_ticks - requested_ticks : 0;
+}
+
+static void UpdateSleepGranularity(FramePacer* const pacer, const Uint64 oversleep)
+{
+	const Uint64 minimum_ticks = MicrosecondsToTicks(pacer, MINIMUM_SPIN_MICROSECONDS);
+
+	/* Jump straight up to a worse oversleep, but only creep back down, so that a one-off does not leave the pacer spinning for good. */
+	if (oversleep > pacer->sleep_granularity)
+		pacer->sleep_granularity = oversleep;
+	else
+		pacer->sleep_granularity -= (pacer->sleep_granularity - oversleep) / SLEEP_GRANULARITY_DECAY;
+
+	pacer->sleep_granularity = SDL_max(pacer->sleep_granularity, minimum_ticks);
+}
+
+static void SleepUntil(FramePacer* const pacer, const Uint64 target)
+{
+	const Uint64 ticks_per_millisecond = MicrosecondsToTicks(pacer, MICROSECONDS_PER_MILLISECOND);
+
+	/* Sleep coarsely, re-checking each time in case the OS oversleeps. */
+	for (;;)
+	{
+		const Uint64 now = SDL_GetPerformanceCounter();
+		Uint32 milliseconds;
+
+		if (now + pacer->sleep_granularity >= target)
+			break;
+
+		milliseconds = (Uint32)((target - pacer->sleep_granularity - now) / ticks_per_millisecond);
+
+		if (milliseconds == 0)
+			break;
+
+		UpdateSleepGranularity(pacer, TimedDelay(pacer, milliseconds));
+	}
+
+	/* Spin for the remainder. */
+	while (SDL_GetPerformanceCounter() < target);
+}
+
+/**************
+* Frame delay *
+**************/
+
+static int CompareTicks(const void* const a, const void* const b)
+{
+	const Uint64 ticks_a = *(const Uint64*)a;
+	const Uint64 ticks_b = *(const Uint64*)b;
+
+	return (ticks_a > ticks_b) - (ticks_a < ticks_b);
+}
+
+static void ResetFrameDelay(FramePacer* const pacer)
+{
+	pacer->frame_delay = 0;
+	pacer->applied_frame_delay = 0;
+	pacer->frame_start = 0;
+	pacer->total_work_samples = 0;
+	pacer->work_sample_index = 0;
+	pacer->frames_until_frame_delay_update = FRAME_DELAY_UPDATE_FRAMES;
+}
+
+static void UpdateFrameDelay(FramePacer* const pacer)
+{
+	Uint64 sorted_samples[FRAME_PACER_WORK_SAMPLES];
+	Uint64 slowest_work, spare_ticks;
+
+	SDL_memcpy(sorted_samples, pacer->work_samples, sizeof(*sorted_samples) * pacer->total_work_samples);
+	SDL_qsort(sorted_samples, pacer->total_work_samples, sizeof(*sorted_samples), CompareTicks);
+
+	slowest_work = sorted_samples[(pacer->total_work_samples * 99 - 1) / 100] + MicrosecondsToTicks(pacer, FRAME_DELAY_MARGIN_MICROSECONDS);
+	spare_ticks = (Uint64)pacer->period;
+
+	pacer->frame_delay = slowest_work < spare_ticks ? spare_ticks - slowest_work : 0;
+}
+
+/* Called as each frame finishes, with how late it finished. */
+static void MeasureFrame(FramePacer* const pacer, const Uint64 now)
+{
+	if (pacer->frame_delay_enabled && pacer->frame_start != 0)
+	{
+		pacer->work_samples[pacer->work_sample_index] = now - pacer->frame_start;
+		pacer->work_sample_index = (pacer->work_sample_index + 1) % FRAME_PACER_WORK_SAMPLES;
+		pacer->total_work_samples = SDL_min(pacer->total_work_samples + 1, FRAME_PACER_WORK_SAMPLES);
+
+		if (now > pacer->target && pacer->frame_delay != 0)
+		{
+			/* The frame overran its deadline, so back off straight away instead of waiting for the next update. */
+			pacer->frame_delay /= 2;
+			++pacer->total_frame_delay_overruns;
+		}
+
+		if (--pacer->frames_until_frame_delay_update == 0)
+		{
+			pacer->frames_until_frame_delay_update = FRAME_DELAY_UPDATE_FRAMES;
+			UpdateFrameDelay(pacer);
+		}
+	}
+
+	pacer->frame_start = 0;
+}
+
+/*************
+* Main stuff *
+*************/
+
+void FramePacer_Init(FramePacer* const pacer, const double frames_per_second)
+{
+	unsigned int i;
+
+	pacer->frequency = SDL_GetPerformanceFrequency();
+
+	/* Time a few of the shortest sleeps, so that the very first deadline is not overslept. */
+	pacer->sleep_granularity = MicrosecondsToTicks(pacer, MINIMUM_SPIN_MICROSECONDS);
+
+	for (i = 0; i < SLEEP_CALIBRATION_SAMPLES; ++i)
+		pacer->sleep_granularity = SDL_max(pacer->sleep_granularity, TimedDelay(pacer, 1));
+
+	FramePacer_SetRate(pacer, frames_per_second);
+	FramePacer_ResetStatistics(pacer);
+
+	pacer->frameskip_allowed = cc_false;
+	pacer->frameskipping = cc_false;
+	pacer->struggling_frames = 0;
+	pacer->comfortable_frames = 0;
+
+	pacer->frame_delay_enabled = cc_false;
+	ResetFrameDelay(pacer);
+}
+
+void FramePacer_SetRate(FramePacer* const pacer, const double frames_per_second)
+{
+	pacer->period = (double)pacer->frequency / frames_per_second;
+
+	FramePacer_Reset(pacer);
+}
+
+void FramePacer_Reset(FramePacer* const pacer)
+{
+	/* The next call to 'FramePacer_Wait' will resynchronise to the current time. */
+	pacer->synchronised = cc_false;
+	pacer->frame_start = 0;
+	pacer->applied_frame_delay = 0;
+}
+
+void FramePacer_SetFrameskip(FramePacer* const pacer, const cc_bool allowed)
+{
+	pacer->frameskip_allowed = allowed;
+	pacer->frameskipping = pacer->frameskipping && allowed;
+}
+
+void FramePacer_SetFrameDelay(FramePacer* const pacer, const cc_bool enabled)
+{
+	pacer->frame_delay_enabled = enabled;
+
+	ResetFrameDelay(pacer);
+}
+
+/* Returns how many frames the caller should run without showing them, to catch up. */
+unsigned int FramePacer_Wait(FramePacer* const pacer)
+{
+	const Uint64 now = SDL_GetPerformanceCounter();
+	/* A frame that was held back by the frame delay finishes later without being any slower, so that should not count against it. */
+	const double frame_delay = (double)pacer->applied_frame_delay;
+	unsigned int frames_to_skip = 0;
+
+	MeasureFrame(pacer, now);
+	pacer->applied_frame_delay = 0;
+
+	if (!pacer->synchronised)
+	{
+		Resynchronise(pacer, now);
+		pacer->synchronised = cc_true;
+	}
+	else if (now >= pacer->target + (Uint64)pacer->period)
+	{
+		/* We are more than a whole frame behind. */
+		const double frames_behind = (double)(now - pacer->target) / pacer->period;
+
+		UpdateFrameskip(pacer, (double)(now - pacer->target) - frame_delay);
+
+		if (pacer->frameskipping && frames_behind < MAX_FRAMESKIP + 1)
+		{
+			/* Catch up by running the missed frames without presenting them, which keeps the audio fed. */
+			unsigned int i;
+
+			frames_to_skip = (unsigned int)frames_behind;
+
+			for (i = 0; i < frames_to_skip; ++i)
+				AdvanceTarget(pacer);
+
+			pacer->total_skipped_frames += frames_to_skip;
+		}
+		else
+		{
+			/* Give up on catching up, as that would just cause a burst of frames. */
+			++pacer->total_missed_frames;
+
+			Resynchronise(pacer, now);
+		}
+	}
+	else
+	{
+		double error;
+
+		UpdateFrameskip(pacer, (double)now - (double)pacer->target - frame_delay);
+
+		if (now < pacer->target)
+			SleepUntil(pacer, pacer->target);
+
+		error = (double)(SDL_GetPerformanceCounter() - pacer->target) / pacer->frequency;
+
+		pacer->error_total += error;
+		pacer->error_squared_total += error * error;
+		pacer->error_maximum = SDL_max(pacer->error_maximum, error);
+		++pacer->total_frames;
+
+		/* Hold the next frame back for as long as it can afford, so that it polls its input as late as possible. */
+		if (pacer->frame_delay_enabled)
+		{
+			if (pacer->frame_delay != 0)
+				SleepUntil(pacer, pacer->target + pacer->frame_delay);
+
+			pacer->applied_frame_delay = pacer->frame_delay;
+
+			pacer->frame_start = SDL_GetPerformanceCounter();
+		}
+	}
+
+	AdvanceTarget(pacer);
+
+	return frames_to_skip;
+}
+
+void FramePacer_GetStatistics(const FramePacer* const pacer, FramePacer_Statistics* const statistics)
+{
+	if (pacer->total_frames == 0)
+	{
+		statistics->mean_error = 0.0;
+		statistics->standard_deviation = 0.0;
+	}
+	else
+	{
+		const double mean = pacer->error_total / pacer->total_frames;
+
+		statistics->mean_error = mean;
+		statistics->standard_deviation = SDL_sqrt(SDL_max(0.0, pacer->error_squared_total / pacer->total_frames - mean * mean));
+	}
+
+	statistics->maximum_error = pacer->error_maximum;
+	statistics->total_frames = pacer->total_frames;
+	statistics->total_missed_frames = pacer->total_missed_frames;
+	statistics->total_skipped_frames = pacer->total_skipped_frames;
+	statistics->frame_delay = (double)pacer->frame_delay / pacer->frequency;
+	statistics->total_frame_delay_overruns = pacer->total_frame_delay_overruns;
+}
+
+void FramePacer_ResetStatistics(FramePacer* const pacer)
+{
+	pacer->error_total = 0.0;
+	pacer->error_squared_total = 0.0;
+	pacer->error_maximum = 0.0;
+	pacer->total_frames = 0;
+	pacer->total_missed_frames = 0;
+	pacer->total_skipped_frames = 0;
+	pacer->total_frame_delay_overruns = 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "SDL.h"
+
+#include "clowncommon/clowncommon.h"
+
+/* How many of the most recent frames' running times the frame delay is based on. */
+#define FRAME_PACER_WORK_SAMPLES 128
+
+typedef struct FramePacer_Statistics
+{
+	/* How late the pacer woke up compared to when it was meant to, in seconds. */
+	double mean_error, maximum_error, standard_deviation;
+	unsigned long total_frames, total_missed_frames, total_skipped_frames;
+	/* How long the pacer currently waits after each deadline before letting the next frame start, in seconds. */
+	double frame_delay;
+	unsigned long total_frame_delay_overruns;
+} FramePacer_Statistics;
+
+typedef struct FramePacer
+{
+	Uint64 frequency;
+	double period;
+
+	/* The target is kept as whole counter ticks plus a fraction, so that rounding does not accumulate into drift. */
+	Uint64 target;
+	double target_fraction;
+	cc_bool synchronised;
+
+	/* How late SDL_Delay wakes up, which is how long before a deadline the pacer has to stop sleeping and start spinning. */
+	Uint64 sleep_granularity;
+
+	/* Frameskipping only kicks in after a run of late frames, and only stops after a run of comfortable ones, so that it does not flip-flop. */
+	cc_bool frameskip_allowed;
+	cc_bool frameskipping;
+	unsigned int struggling_frames, comfortable_frames;
+
+	/* The frame delay starts each frame as late as its running time allows, so that its input is as fresh as possible when it is shown. */
+	cc_bool frame_delay_enabled;
+	Uint64 frame_delay, applied_frame_delay;
+	Uint64 frame_start; /* Zero if the last frame's running time cannot be measured. */
+	Uint64 work_samples[FRAME_PACER_WORK_SAMPLES];
+	unsigned int total_work_samples, work_sample_index, frames_until_frame_delay_update;
+	unsigned long total_frame_delay_overruns;
+
+	double error_total, error_squared_total, error_maximum;
+	unsigned long total_frames, total_missed_frames, total_skipped_frames;
+} FramePacer;
+
+void FramePacer_Init(FramePacer *pacer, double frames_per_second);
+void FramePacer_SetRate(FramePacer *pacer, double frames_per_second);
+void FramePacer_Reset(FramePacer *pacer);
+void FramePacer_SetFrameskip(FramePacer *pacer, cc_bool allowed);
+void FramePacer_SetFrameDelay(FramePacer *pacer, cc_bool enabled);
+unsigned int FramePacer_Wait(FramePacer *pacer);
+void FramePacer_GetStatistics(const FramePacer *pacer, FramePacer_Statistics *statistics);
+void FramePacer_ResetStatistics(FramePacer *pacer);
@@ -2,6 +2,8 @@
 
 #include <assert.h>
 
+#include "latency_meter.h"
+
 #define AXIS_MAX 0x7FFF
 
 Retropad retropad;
@@ -18,3 +20,181 @@ void Input_SetButtonAnalog(const unsigned int index, const short axis)
 	retropad.buttons[index].axis = axis;
 	retropad.buttons[index].held = axis >= AXIS_MAX / 4;
 }
+
+static cc_bool ApplyEvent(const SDL_Event* const event)
+{
+	switch (event->type)
+	{
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+		{
+			const cc_bool held = event->key.state == SDL_PRESSED;
+
+			switch (event->key.keysym.scancode)
+			{
+			#define DO_KEY(INPUT, OUTPUT)\
+				case INPUT:\
+					retropad.buttons[OUTPUT].held = held;\
+					return cc_true
+
+				DO_KEY(SDL_SCANCODE_W, RETRO_DEVICE_ID_JOYPAD_UP);
+				DO_KEY(SDL_SCANCODE_A, RETRO_DEVICE_ID_JOYPAD_LEFT);
+				DO_KEY(SDL_SCANCODE_S, RETRO_DEVICE_ID_JOYPAD_DOWN);
+				DO_KEY(SDL_SCANCODE_D, RETRO_DEVICE_ID_JOYPAD_RIGHT);
+				DO_KEY(SDL_SCANCODE_P, RETRO_DEVICE_ID_JOYPAD_A);
+				DO_KEY(SDL_SCANCODE_O, RETRO_DEVICE_ID_JOYPAD_B);
+				DO_KEY(SDL_SCANCODE_0, RETRO_DEVICE_ID_JOYPAD_X);
+				DO_KEY(SDL_SCANCODE_9, RETRO_DEVICE_ID_JOYPAD_Y);
+				DO_KEY(SDL_SCANCODE_8, RETRO_DEVICE_ID_JOYPAD_L);
+				DO_KEY(SDL_SCANCODE_7, RETRO_DEVICE_ID_JOYPAD_L2);
+				DO_KEY(SDL_SCANCODE_L, RETRO_DEVICE_ID_JOYPAD_L3);
+				DO_KEY(SDL_SCANCODE_MINUS, RETRO_DEVICE_ID_JOYPAD_R);
+				DO_KEY(SDL_SCANCODE_EQUALS, RETRO_DEVICE_ID_JOYPAD_R2);
+				DO_KEY(SDL_SCANCODE_SEMICOLON, RETRO_DEVICE_ID_JOYPAD_R3);
+				DO_KEY(SDL_SCANCODE_BACKSPACE, RETRO_DEVICE_ID_JOYPAD_SELECT);
+			#undef DO_KEY
+
+				case SDL_SCANCODE_RETURN:
+					/* Alt+Enter toggles fullscreen instead. */
+					if (!held || (event->key.keysym.mod & KMOD_LALT) == 0)
+						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_START].held = held;
+
+					return cc_true;
+
+				default:
+					break;
+			}
+
+			break;
+		}
+
+		case SDL_CONTROLLERBUTTONDOWN:
+		case SDL_CONTROLLERBUTTONUP:
+		{
+			unsigned int retropad_index = -1;
+
+			switch (event->cbutton.button)
+			{
+			#define DO_BUTTON(INPUT, OUTPUT)\
+				case INPUT:\
+					retropad_index = OUTPUT;\
+					break
+
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_A, RETRO_DEVICE_ID_JOYPAD_B);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_B, RETRO_DEVICE_ID_JOYPAD_A);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_X, RETRO_DEVICE_ID_JOYPAD_Y);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_Y, RETRO_DEVICE_ID_JOYPAD_X);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_BACK, RETRO_DEVICE_ID_JOYPAD_SELECT);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_START, RETRO_DEVICE_ID_JOYPAD_START);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_LEFTSTICK, RETRO_DEVICE_ID_JOYPAD_L3);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_RIGHTSTICK, RETRO_DEVICE_ID_JOYPAD_R3);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_LEFTSHOULDER, RETRO_DEVICE_ID_JOYPAD_L);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_RIGHTSHOULDER, RETRO_DEVICE_ID_JOYPAD_R);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_UP, RETRO_DEVICE_ID_JOYPAD_UP);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_DOWN, RETRO_DEVICE_ID_JOYPAD_DOWN);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_LEFT, RETRO_DEVICE_ID_JOYPAD_LEFT);
+				DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_RIGHT, RETRO_DEVICE_ID_JOYPAD_RIGHT);
+			#undef DO_BUTTON
+			}
+
+			if (retropad_index != (unsigned int)-1)
+			{
+				Input_SetButtonDigital(retropad_index, event->cbutton.state == SDL_PRESSED);
+				return cc_true;
+			}
+
+			break;
+		}
+
+		case SDL_CONTROLLERAXISMOTION:
+			switch (event->caxis.axis)
+			{
+				case SDL_CONTROLLER_AXIS_TRIGGERLEFT:
+					Input_SetButtonAnalog(RETRO_DEVICE_ID_JOYPAD_L2, event->caxis.value);
+					return cc_true;
+
+				case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
+					Input_SetButtonAnalog(RETRO_DEVICE_ID_JOYPAD_R2, event->caxis.value);
+					return cc_true;
+
+				case SDL_CONTROLLER_AXIS_LEFTX:
+					retropad.sticks[0].axis[0] = event->caxis.value;
+					return cc_true;
+
+				case SDL_CONTROLLER_AXIS_LEFTY:
+					retropad.sticks[0].axis[1] = event->caxis.value;
+					return cc_true;
+
+				case SDL_CONTROLLER_AXIS_RIGHTX:
+					retropad.sticks[1].axis[0] = event->caxis.value;
+					return cc_true;
+
+				case SDL_CONTROLLER_AXIS_RIGHTY:
+					retropad.sticks[1].axis[1] = event->caxis.value;
+					return cc_true;
+			}
+
+			break;
+	}
+
+	return cc_false;
+}
+
+/* Works out when SDL received an event, as a performance counter value. */
+static Uint64 GetEventTime(const SDL_Event* const event)
+{
+	const Uint64 now = SDL_GetPerformanceCounter();
+	const Uint32 age = SDL_GetTicks() - event->common.timestamp;
+
+	/* The timestamp is only accurate to a millisecond, and events that were pushed by hand might not have one at all. */
+	if (age > 1000)
+		return now;
+	else
+		return now - (Uint64)age * SDL_GetPerformanceFrequency() / 1000;
+}
+
+/* Applies an event to the Retropad, returning whether it had anything to do with it. */
+cc_bool Input_HandleEvent(const SDL_Event* const event)
+{
+	cc_bool previously_held[CC_COUNT_OF(retropad.buttons)];
+	cc_bool handled;
+	unsigned int i;
+
+	for (i = 0; i < CC_COUNT_OF(retropad.buttons); ++i)
+		previously_held[i] = retropad.buttons[i].held;
+
+	handled = ApplyEvent(event);
+
+	/* Only buttons count as an input change: analogue sticks jitter too much to follow. */
+	/* Events that were already applied by 'Input_Poll' change nothing the second time around, so they are not counted twice. */
+	for (i = 0; i < CC_COUNT_OF(retropad.buttons); ++i)
+	{
+		if (retropad.buttons[i].held != previously_held[i])
+		{
+			LatencyMeter_InputChanged(GetEventTime(event));
+			break;
+		}
+	}
+
+	return handled;
+}
+
+/* Brings the Retropad up to date without removing any events from the queue, so that the main loop still sees them for hotkeys and such. */
+/* This must only be called from the main thread. */
+void Input_Poll(void)
+{
+	SDL_Event events[0x40];
+	int total_events, i;
+
+	SDL_PumpEvents();
+
+	total_events = SDL_PeepEvents(events, CC_COUNT_OF(events), SDL_PEEKEVENT, SDL_KEYDOWN, SDL_KEYUP);
+
+	for (i = 0; i < total_events; ++i)
+		Input_HandleEvent(&events[i]);
+
+	total_events = SDL_PeepEvents(events, CC_COUNT_OF(events), SDL_PEEKEVENT, SDL_CONTROLLERAXISMOTION, SDL_CONTROLLERBUTTONUP);
+
+	for (i = 0; i < total_events; ++i)
+		Input_HandleEvent(&events[i]);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "SDL.h"
+
 #include "clowncommon/clowncommon.h"
 
 #include "libretro.h"
@@ -22,3 +24,5 @@ extern Retropad retropad;
 
 void Input_SetButtonDigital(unsigned int index, cc_bool held);
 void Input_SetButtonAnalog(unsigned int index, short axis);
+cc_bool Input_HandleEvent(const SDL_Event *event);
+void Input_Poll(void);
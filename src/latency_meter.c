@@ -0,0 +1,173 @@
+#include "latency_meter.h"
+
+#include <limits.h>
+#include <stddef.h>
+
+#include "SDL.h"
+
+#include "error.h"
+
+/* The most recent this-many input changes are kept for the report. */
+#define TOTAL_SAMPLES 0x1000
+
+/* An input change goes through these stages in order, and only one is followed at a time. */
+typedef enum Stage
+{
+	STAGE_IDLE,
+	STAGE_CHANGED,  /* SDL has delivered it, but the core has not read it yet. */
+	STAGE_READ,     /* The core has read it during a frame. */
+	STAGE_FINISHED, /* The frame that read it has been completed, and is waiting to be shown. */
+	STAGE_DRAWN     /* A frame that includes it has been drawn, and is waiting to be presented. */
+} Stage;
+
+static cc_bool enabled;
+
+/* The input is changed on the main thread, but may be read by the emulation thread. */
+static SDL_SpinLock lock;
+static SDL_atomic_t stage;
+static Uint64 change_time, read_time;
+
+/* Every input change gets a number, so that input and frames which predate the measured change can be told apart from ones which include it. */
+static unsigned int latest_sequence, measured_sequence;
+
+static double change_to_read_samples[TOTAL_SAMPLES];
+static double change_to_present_samples[TOTAL_SAMPLES];
+static size_t total_samples, sample_index;
+
+static int CompareSamples(const void* const a, const void* const b)
+{
+	const double sample_a = *(const double*)a;
+	const double sample_b = *(const double*)b;
+
+	return (sample_a > sample_b) - (sample_a < sample_b);
+}
+
+static void ReportSamples(const char* const name, double* const samples)
+{
+	SDL_qsort(samples, total_samples, sizeof(*samples), CompareSamples);
+
+	PrintInfo("%s: median %.3fms, p90 %.3fms, p99 %.3fms, maximum %.3fms", name,
+		samples[(total_samples - 1) / 2], samples[(total_samples * 90 - 1) / 100], samples[(total_samples * 99 - 1) / 100], samples[total_samples - 1]);
+}
+
+/* Moves from one stage to the next, returning false if the input change was not at the expected stage. */
+static cc_bool Advance(const Stage from, const Stage to)
+{
+	return SDL_AtomicCAS(&stage, from, to);
+}
+
+/* Input and frames carry the sequence number of the newest input change that they include. */
+static cc_bool IncludesMeasuredChange(const unsigned int input_sequence)
+{
+	cc_bool included;
+
+	SDL_AtomicLock(&lock);
+	/* This is written to cope with the numbers wrapping around. */
+	included = input_sequence - measured_sequence <= UINT_MAX / 2;
+	SDL_AtomicUnlock(&lock);
+
+	return included;
+}
+
+/*************
+* Main stuff *
+*************/
+
+void LatencyMeter_Init(void)
+{
+	enabled = cc_true;
+	total_samples = 0;
+	sample_index = 0;
+	SDL_AtomicSet(&stage, STAGE_IDLE);
+}
+
+void LatencyMeter_Deinit(void)
+{
+	if (enabled)
+	{
+		if (total_samples == 0)
+		{
+			PrintInfo("No input changes were seen, so input latency could not be measured");
+		}
+		else
+		{
+			PrintInfo("Input latency over %lu input changes:", (unsigned long)total_samples);
+			ReportSamples("Input to core", change_to_read_samples);
+			ReportSamples("Input to display", change_to_present_samples);
+		}
+	}
+
+	enabled = cc_false;
+}
+
+/* 'time' is a performance counter value. */
+void LatencyMeter_InputChanged(const Uint64 time)
+{
+	if (enabled)
+	{
+		++latest_sequence;
+
+		/* If an earlier change has not been shown yet, then that one is still the one being measured. */
+		if (SDL_AtomicGet(&stage) == STAGE_IDLE)
+		{
+			SDL_AtomicLock(&lock);
+			change_time = time;
+			measured_sequence = latest_sequence;
+			SDL_AtomicUnlock(&lock);
+
+			Advance(STAGE_IDLE, STAGE_CHANGED);
+		}
+	}
+}
+
+/* Must be called on the main thread, when the input is handed over to whichever thread is running the core. */
+unsigned int LatencyMeter_GetInputSequence(void)
+{
+	return latest_sequence;
+}
+
+/* Called whenever the core reads its input, so this has to be cheap when nothing is being measured. */
+/* Input that was handed over before the change does not count, even if it is read afterwards. */
+void LatencyMeter_InputRead(const unsigned int input_sequence)
+{
+	if (enabled && SDL_AtomicGet(&stage) == STAGE_CHANGED && IncludesMeasuredChange(input_sequence))
+	{
+		SDL_AtomicLock(&lock);
+		read_time = SDL_GetPerformanceCounter();
+		SDL_AtomicUnlock(&lock);
+
+		Advance(STAGE_CHANGED, STAGE_READ);
+	}
+}
+
+void LatencyMeter_FrameFinished(void)
+{
+	if (enabled)
+		Advance(STAGE_READ, STAGE_FINISHED);
+}
+
+/* Older frames may still be drawn after the one that read the change has finished, so they do not count. */
+void LatencyMeter_FrameDrawn(const unsigned int input_sequence)
+{
+	if (enabled && SDL_AtomicGet(&stage) == STAGE_FINISHED && IncludesMeasuredChange(input_sequence))
+		Advance(STAGE_FINISHED, STAGE_DRAWN);
+}
+
+void LatencyMeter_FramePresented(void)
+{
+	if (enabled && SDL_AtomicGet(&stage) == STAGE_DRAWN)
+	{
+		const Uint64 present_time = SDL_GetPerformanceCounter();
+		const double ticks_per_millisecond = SDL_GetPerformanceFrequency() / 1000.0;
+
+		SDL_AtomicLock(&lock);
+		change_to_read_samples[sample_index] = (double)(read_time - change_time) / ticks_per_millisecond;
+		change_to_present_samples[sample_index] = (double)(present_time - change_time) / ticks_per_millisecond;
+		SDL_AtomicUnlock(&lock);
+
+		sample_index = (sample_index + 1) % TOTAL_SAMPLES;
+		total_samples = SDL_min(total_samples + 1, TOTAL_SAMPLES);
+
+		Advance(STAGE_DRAWN, STAGE_IDLE);
+	}
+}
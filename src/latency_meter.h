@@ -0,0 +1,14 @@
+#pragma once
+
+#include "SDL.h"
+
+#include "clowncommon/clowncommon.h"
+
+void LatencyMeter_Init(void);
+void LatencyMeter_Deinit(void);
+void LatencyMeter_InputChanged(Uint64 time);
+unsigned int LatencyMeter_GetInputSequence(void);
+void LatencyMeter_InputRead(unsigned int input_sequence);
+void LatencyMeter_FrameFinished(void);
+void LatencyMeter_FrameDrawn(unsigned int input_sequence);
+void LatencyMeter_FramePresented(void);
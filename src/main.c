@@ -1,24 +1,50 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "SDL.h"
 
 #include "audio.h"
 #include "core_runner.h"
 #include "error.h"
+#include "frame_pacer.h"
 #include "input.h"
+#include "latency_meter.h"
 #include "menu.h"
+#include "profiler.h"
 #include "video.h"
 
 static bool audio_initialised;
 
 static double frames_per_second;
+static FramePacer frame_pacer;
+static double paced_frames_per_second;
 
 static bool menu_open;
 
+static bool rewind_held;
+static bool fast_forward;
+static bool show_audio_statistics;
+static unsigned int savestate_slot;
+
 static Menu *menu;
 
+static bool headless;
+static unsigned long benchmark_frames;
+static bool resample_audio = true;
+static bool allow_threading = true;
+static bool threaded;
+static bool allow_frameskip = true;
+static bool frame_delay;
+static bool measure_latency;
+static unsigned int frames_to_skip;
+static const char *record_movie_path;
+static const char *play_movie_path;
+static const char *trace_path;
+static unsigned int minimum_audio_latency = 20;
+static unsigned int maximum_audio_latency = 200;
+
 /*******
 * Main *
 *******/
@@ -67,10 +93,30 @@ static int OptionsMenuCallback(Menu_Option *option, Menu_CallbackAction action,
 	return 0; /* TODO */
 }
 
+static void FormatAudioStatistics(char* const buffer, const size_t buffer_size, const Audio_Statistics* const statistics)
+{
+	size_t i, length;
+
+	length = SDL_snprintf(buffer, buffer_size,
+		"Audio queue: %lu frames, target %lu frames\n"
+		"Rate control ratio: %.5f (minimum %.5f, mean %.5f, maximum %.5f)\n"
+		"Underruns: %lu, dropped frames: %lu, overflowed frames: %lu\n"
+		"Queue depth (quarters of target):",
+		(unsigned long)statistics->queued_frames, (unsigned long)statistics->target_frames,
+		statistics->ratio, statistics->minimum_ratio, statistics->mean_ratio, statistics->maximum_ratio,
+		statistics->underruns, statistics->dropped_frames, statistics->overflowed_frames);
+
+	for (i = 0; i < AUDIO_QUEUE_HISTOGRAM_BUCKETS && length < buffer_size; ++i)
+		length += SDL_snprintf(&buffer[length], buffer_size - length, " %.0f%%", statistics->total_pushes == 0 ? 0.0 : statistics->queue_depth_histogram[i] * 100.0 / statistics->total_pushes);
+}
+
 static void ToggleMenu(void)
 {
 	menu_open = !menu_open;
 
+	/* The menu edits the core's options, so the core must not be running while it is open. */
+	CoreRunner_SetPaused(menu_open);
+
 	if (menu_open)
 	{
 		Variable *variables;
@@ -113,18 +159,21 @@ static cc_bool Iterate(void)
 	bool quit;
 	SDL_Event event;
 	size_t i;
-	cc_bool previous_held_buttons[CC_COUNT_OF(retropad.buttons)];
+	/* This is kept from the last time that presses were detected, as the core polling its input can update the Retropad in between. */
+	static cc_bool previous_held_buttons[CC_COUNT_OF(retropad.buttons)];
 
 	quit = false;
 
-	for (i = 0; i < CC_COUNT_OF(previous_held_buttons); ++i)
-		previous_held_buttons[i] = retropad.buttons[i].held;
-
 	/* Handle events */
+	Profiler_Begin("Events");
+
 	while (SDL_PollEvent(&event))
 	{
 		static bool alt_held;
 
+		/* The core may have already seen this event if it polled its input late, but doing it again is harmless. */
+		Input_HandleEvent(&event);
+
 		switch (event.type)
 		{
 			case SDL_QUIT:
@@ -173,67 +222,82 @@ static cc_bool Iterate(void)
 						}
 
 						break;
-				}
 
-				switch (event.key.keysym.scancode)
-				{
-					case SDL_SCANCODE_W:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_UP].held = event.key.state == SDL_PRESSED;
-						break;
+					case SDLK_F3:
+					case SDLK_F4:
+						if (event.key.state == SDL_PRESSED)
+						{
+							static bool run_ahead_preemptive;
 
-					case SDL_SCANCODE_A:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_LEFT].held = event.key.state == SDL_PRESSED;
-						break;
+							/* The core runner turns run-ahead off by itself if it fails or is too slow, so start from what is actually in effect. */
+							unsigned int run_ahead_frames = CoreRunner_GetRunAhead();
 
-					case SDL_SCANCODE_S:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_DOWN].held = event.key.state == SDL_PRESSED;
-						break;
+							/* F3 cycles through how many frames to run ahead, while F4 toggles preemptive frames. */
+							if (event.key.keysym.sym == SDLK_F3)
+								run_ahead_frames = (run_ahead_frames + 1) % 4;
+							else
+								run_ahead_preemptive = !run_ahead_preemptive;
 
-					case SDL_SCANCODE_D:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_RIGHT].held = event.key.state == SDL_PRESSED;
-						break;
+							CoreRunner_SetRunAhead(run_ahead_frames, run_ahead_preemptive);
+							PrintInfo("Run-ahead: %u frames%s", CoreRunner_GetRunAhead(), run_ahead_preemptive ? ", preemptive" : "");
+						}
 
-					case SDL_SCANCODE_P:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_A].held = event.key.state == SDL_PRESSED;
 						break;
 
-					case SDL_SCANCODE_O:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_B].held = event.key.state == SDL_PRESSED;
-						break;
+					case SDLK_SPACE:
+						if (event.key.state == SDL_PRESSED)
+						{
+							fast_forward = !fast_forward;
+							CoreRunner_SetFastForwarding(fast_forward);
+						}
 
-					case SDL_SCANCODE_0:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_X].held = event.key.state == SDL_PRESSED;
 						break;
 
-					case SDL_SCANCODE_9:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_Y].held = event.key.state == SDL_PRESSED;
-						break;
+					case SDLK_F5:
+						if (event.key.state == SDL_PRESSED)
+						{
+							static bool rewind_enabled;
 
-					case SDL_SCANCODE_8:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_L].held = event.key.state == SDL_PRESSED;
-						break;
+							rewind_enabled = !rewind_enabled;
+
+							if (!CoreRunner_SetRewind(rewind_enabled))
+								rewind_enabled = false;
+						}
 
-					case SDL_SCANCODE_7:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_L2].held = event.key.state == SDL_PRESSED;
 						break;
 
-					case SDL_SCANCODE_L:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_L3].held = event.key.state == SDL_PRESSED;
+					case SDLK_F6:
+						if (event.key.state == SDL_PRESSED)
+							CoreRunner_SaveState(savestate_slot);
+
 						break;
 
-					case SDL_SCANCODE_MINUS:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_R].held = event.key.state == SDL_PRESSED;
+					case SDLK_F7:
+						if (event.key.state == SDL_PRESSED)
+							CoreRunner_LoadState(savestate_slot);
+
 						break;
 
-					case SDL_SCANCODE_EQUALS:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_R2].held = event.key.state == SDL_PRESSED;
+					case SDLK_F8:
+						if (event.key.state == SDL_PRESSED)
+						{
+							savestate_slot = (savestate_slot + 1) % 10;
+							PrintInfo("Savestate slot %u selected", savestate_slot);
+						}
+
 						break;
 
-					case SDL_SCANCODE_SEMICOLON:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_R3].held = event.key.state == SDL_PRESSED;
+					case SDLK_F11:
+						if (event.key.state == SDL_PRESSED)
+							show_audio_statistics = !show_audio_statistics;
+
 						break;
+				}
 
+				switch (event.key.keysym.scancode)
+				{
 					case SDL_SCANCODE_RETURN:
+						/* Without Alt, this is the Start button, which is handled by the input code. */
 						if (event.key.state == SDL_PRESSED && alt_held)
 						{
 							static bool fullscreen = false;
@@ -241,18 +305,13 @@ static cc_bool Iterate(void)
 
 							Video_SetFullscreen(fullscreen);
 						}
-						else
-						{
-							retropad.buttons[RETRO_DEVICE_ID_JOYPAD_START].held = event.key.state == SDL_PRESSED;
-						}
 
 						break;
 
-					case SDL_SCANCODE_BACKSPACE:
-						retropad.buttons[RETRO_DEVICE_ID_JOYPAD_SELECT].held = event.key.state == SDL_PRESSED;
+					case SDL_SCANCODE_R:
+						rewind_held = event.key.state == SDL_PRESSED;
 						break;
 
-
 					case SDL_SCANCODE_ESCAPE:
 						if (event.key.state == SDL_PRESSED)
 							ToggleMenu();
@@ -265,79 +324,19 @@ static cc_bool Iterate(void)
 
 				break;
 
-			case SDL_CONTROLLERBUTTONDOWN:
-			case SDL_CONTROLLERBUTTONUP:
-			{
-				unsigned int retropad_index = -1;
-
-				switch (event.cbutton.button)
-				{
-				#define DO_BUTTON(INPUT, OUTPUT)\
-					case INPUT:\
-						retropad_index = OUTPUT;\
-						break
-
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_A, RETRO_DEVICE_ID_JOYPAD_B);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_B, RETRO_DEVICE_ID_JOYPAD_A);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_X, RETRO_DEVICE_ID_JOYPAD_Y);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_Y, RETRO_DEVICE_ID_JOYPAD_X);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_BACK, RETRO_DEVICE_ID_JOYPAD_SELECT);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_START, RETRO_DEVICE_ID_JOYPAD_START);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_LEFTSTICK, RETRO_DEVICE_ID_JOYPAD_L3);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_RIGHTSTICK, RETRO_DEVICE_ID_JOYPAD_R3);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_LEFTSHOULDER, RETRO_DEVICE_ID_JOYPAD_L);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_RIGHTSHOULDER, RETRO_DEVICE_ID_JOYPAD_R);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_UP, RETRO_DEVICE_ID_JOYPAD_UP);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_DOWN, RETRO_DEVICE_ID_JOYPAD_DOWN);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_LEFT, RETRO_DEVICE_ID_JOYPAD_LEFT);
-					DO_BUTTON(SDL_CONTROLLER_BUTTON_DPAD_RIGHT, RETRO_DEVICE_ID_JOYPAD_RIGHT);
-				#undef DO_BUTTON
-				}
-
-				if (retropad_index != (unsigned int)-1)
-					Input_SetButtonDigital(retropad_index, event.cbutton.state == SDL_PRESSED);
-
-				break;
-			}
-
-			case SDL_CONTROLLERAXISMOTION:
-				switch (event.caxis.axis)
-				{
-					case SDL_CONTROLLER_AXIS_TRIGGERLEFT:
-						Input_SetButtonAnalog(RETRO_DEVICE_ID_JOYPAD_L2, event.caxis.value);
-						break;
-
-					case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
-						Input_SetButtonAnalog(RETRO_DEVICE_ID_JOYPAD_R2, event.caxis.value);
-						break;
-
-					case SDL_CONTROLLER_AXIS_LEFTX:
-						retropad.sticks[0].axis[0] = event.caxis.value;
-						break;
-
-					case SDL_CONTROLLER_AXIS_LEFTY:
-						retropad.sticks[0].axis[1] = event.caxis.value;
-						break;
-
-					case SDL_CONTROLLER_AXIS_RIGHTX:
-						retropad.sticks[1].axis[0] = event.caxis.value;
-						break;
-
-					case SDL_CONTROLLER_AXIS_RIGHTY:
-						retropad.sticks[1].axis[1] = event.caxis.value;
-						break;
-				}
-
-				break;
-
 			case SDL_CONTROLLERDEVICEADDED:
 				SDL_GameControllerOpen(event.cdevice.which);
 				break;
 		}
 	}
 
+	Profiler_End();
+
 	for (i = 0; i < CC_COUNT_OF(retropad.buttons); ++i)
+	{
 		retropad.buttons[i].pressed = retropad.buttons[i].held && !previous_held_buttons[i];
+		previous_held_buttons[i] = retropad.buttons[i].held;
+	}
 
 	if (retropad.buttons[RETRO_DEVICE_ID_JOYPAD_L3].pressed && retropad.buttons[RETRO_DEVICE_ID_JOYPAD_R3].pressed)
 		ToggleMenu();
@@ -346,47 +345,231 @@ static cc_bool Iterate(void)
 	{
 		Menu_Update(menu);
 	}
+	else if (threaded)
+	{
+		/* The emulation thread runs the core by itself, so it just needs to be told what the input is. */
+		if (!CoreRunner_SubmitInput(&retropad, rewind_held))
+			quit = true;
+	}
+	else if (rewind_held)
+	{
+		if (!CoreRunner_Rewind())
+			quit = true;
+	}
+	else if (fast_forward)
+	{
+		/* Run as many frames as will fit in the time of a single frame, but only show the last one. */
+		const Uint64 deadline = SDL_GetPerformanceCounter() + SDL_GetPerformanceFrequency() / frames_per_second;
+
+		do
+		{
+			if (!CoreRunner_SkipFrame(cc_false))
+				quit = true;
+		} while (!quit && SDL_GetPerformanceCounter() < deadline);
+
+		if (!CoreRunner_Update())
+			quit = true;
+	}
 	else
 	{
+		/* Catch up on the frames that the pacer says that we fell behind on, without drawing them. */
+		for (; frames_to_skip != 0 && !quit; --frames_to_skip)
+			if (!CoreRunner_SkipFrame(cc_true))
+				quit = true;
+
 		if (!CoreRunner_Update())
 			quit = true;
 	}
 
+	frames_to_skip = 0;
+
 	/* Draw stuff */
 	Video_Clear();
 
+	Profiler_Begin("CoreRunner_Draw");
 	CoreRunner_Draw();
+	Profiler_End();
 
 	if (menu_open)
+	{
+		Profiler_Begin("Menu_Draw");
 		Menu_Draw(menu);
+		Profiler_End();
+	}
+
+	if (show_audio_statistics)
+	{
+		Audio_Statistics statistics;
+
+		if (CoreRunner_GetAudioStatistics(&statistics))
+		{
+			char text[0x200];
 
+			FormatAudioStatistics(text, sizeof(text), &statistics);
+			Menu_DrawOverlay(text);
+		}
+	}
+
+	Profiler_Begin("Video_Display");
 	Video_Display();
+	Profiler_End();
 
+	/* Delay until the next frame */
+	if (paced_frames_per_second != frames_per_second)
 	{
-		/* Delay until the next frame */
-		static double ticks_next;
-		const Uint32 ticks_now = SDL_GetTicks();
+		/* The core changed its frame rate. */
+		paced_frames_per_second = frames_per_second;
+		FramePacer_SetRate(&frame_pacer, frames_per_second);
+	}
 
-		if (ticks_now < ticks_next)
-			SDL_Delay(ticks_next - ticks_now);
+	Profiler_Begin("Pacing");
 
-		ticks_next = SDL_max(ticks_next, ticks_now) + 1000.0 / frames_per_second;
-	}
+	if (fast_forward && !threaded)
+		FramePacer_Reset(&frame_pacer);
+	else
+		frames_to_skip = FramePacer_Wait(&frame_pacer);
+
+	Profiler_End();
 
 	return !quit;
 }
 
+static int CompareFrameTimes(const void* const a, const void* const b)
+{
+	const double time_a = *(const double*)a;
+	const double time_b = *(const double*)b;
+
+	return (time_a > time_b) - (time_a < time_b);
+}
+
+/* Runs the core as fast as possible, and reports how long everything took. */
+static void Benchmark(void)
+{
+	double *frame_times;
+	unsigned long frames_done, i;
+	Uint64 start_time;
+	double total_time, total_frame_time, video_refresh_time, audio_time;
+	Audio_Statistics audio_statistics;
+	bool quit;
+
+	const double frequency = (double)SDL_GetPerformanceFrequency();
+
+	/* Zero frames means to keep going until told to quit. */
+	frame_times = benchmark_frames == 0 ? NULL : (double*)SDL_malloc(sizeof(double) * benchmark_frames);
+
+	if (benchmark_frames != 0 && frame_times == NULL)
+	{
+		PrintError("Could not allocate memory for the frame times");
+		return;
+	}
+
+	quit = false;
+	start_time = SDL_GetPerformanceCounter();
+
+	for (frames_done = 0; !quit && (benchmark_frames == 0 || frames_done < benchmark_frames); ++frames_done)
+	{
+		SDL_Event event;
+		Uint64 frame_start_time;
+
+		while (SDL_PollEvent(&event))
+			if (event.type == SDL_QUIT)
+				quit = true;
+
+		frame_start_time = SDL_GetPerformanceCounter();
+
+		if (!CoreRunner_Update())
+			quit = true;
+
+		/* When benchmarking a movie, stop at the end of it. */
+		if (benchmark_frames == 0 && play_movie_path != NULL && !CoreRunner_IsPlayingMovie())
+			quit = true;
+
+		if (frame_times != NULL)
+			frame_times[frames_done] = (SDL_GetPerformanceCounter() - frame_start_time) / frequency;
+	}
+
+	total_time = (SDL_GetPerformanceCounter() - start_time) / frequency;
+	CoreRunner_GetCallbackTimes(&video_refresh_time, &audio_time);
+
+	printf("Frames: %lu\n", frames_done);
+	printf("Total time: %.3fs\n", total_time);
+	printf("Frames per second: %.2f\n", frames_done / total_time);
+
+	if (frame_times != NULL && frames_done != 0)
+	{
+		total_frame_time = 0.0;
+
+		for (i = 0; i < frames_done; ++i)
+			total_frame_time += frame_times[i];
+
+		SDL_qsort(frame_times, frames_done, sizeof(*frame_times), CompareFrameTimes);
+
+		printf("Frame time: mean %.3fms, p99 %.3fms\n", total_frame_time / frames_done * 1000.0, frame_times[(frames_done * 99 - 1) / 100] * 1000.0);
+	}
+
+	printf("Callback_VideoRefresh: %.3fms total, %.3fms per frame\n", video_refresh_time * 1000.0, frames_done == 0 ? 0.0 : video_refresh_time / frames_done * 1000.0);
+	printf("Callback_AudioSampleBatch: %.3fms total, %.3fms per frame\n", audio_time * 1000.0, frames_done == 0 ? 0.0 : audio_time / frames_done * 1000.0);
+
+	if (CoreRunner_GetAudioStatistics(&audio_statistics))
+	{
+		char text[0x200];
+
+		FormatAudioStatistics(text, sizeof(text), &audio_statistics);
+		printf("%s\n", text);
+	}
+
+	SDL_free(frame_times);
+}
+
 int main(int argc, char **argv)
 {
 	int main_return = EXIT_FAILURE;
+	const char *arguments[2];
+	size_t total_arguments;
+	int i;
+
+	/* Separate the options from the paths. */
+	total_arguments = 0;
+
+	for (i = 1; i < argc; ++i)
+	{
+		if (!SDL_strcmp(argv[i], "--headless"))
+			headless = true;
+		else if (!SDL_strcmp(argv[i], "--frames") && i + 1 < argc)
+			benchmark_frames = SDL_strtoul(argv[++i], NULL, 0);
+		else if (!SDL_strcmp(argv[i], "--no-resample"))
+			resample_audio = false;
+		else if (!SDL_strcmp(argv[i], "--no-thread"))
+			allow_threading = false;
+		else if (!SDL_strcmp(argv[i], "--no-frameskip"))
+			allow_frameskip = false;
+		else if (!SDL_strcmp(argv[i], "--frame-delay"))
+			frame_delay = true;
+		else if (!SDL_strcmp(argv[i], "--latency"))
+			measure_latency = true;
+		else if (!SDL_strcmp(argv[i], "--record") && i + 1 < argc)
+			record_movie_path = argv[++i];
+		else if (!SDL_strcmp(argv[i], "--play") && i + 1 < argc)
+			play_movie_path = argv[++i];
+		else if (!SDL_strcmp(argv[i], "--trace") && i + 1 < argc)
+			trace_path = argv[++i];
+		else if (!SDL_strcmp(argv[i], "--min-latency") && i + 1 < argc)
+			minimum_audio_latency = (unsigned int)SDL_strtoul(argv[++i], NULL, 0);
+		else if (!SDL_strcmp(argv[i], "--max-latency") && i + 1 < argc)
+			maximum_audio_latency = (unsigned int)SDL_strtoul(argv[++i], NULL, 0);
+		else if (argv[i][0] == '-' && argv[i][1] == '-')
+			PrintWarning("Unknown option '%s'", argv[i]);
+		else if (total_arguments < CC_COUNT_OF(arguments))
+			arguments[total_arguments++] = argv[i];
+	}
 
 #ifndef __WIIU__
-	if (argc < 2)
+	if (total_arguments < 1)
 	{
 #ifdef DYNAMIC_CORE
 		PrintError("Core path not specified");
 	}
-	else if (argc < 3)
+	else if (total_arguments < 2)
 	{
 #endif
 		PrintError("Game path not specified");
@@ -404,7 +587,13 @@ int main(int argc, char **argv)
 			/* Enable high-DPI support on Windows because SDL2 is bad at being a platform abstraction library */
 			SDL_SetHint(SDL_HINT_WINDOWS_DPI_SCALING, "1");
 
-			if (!Video_Init(640, 480)) /* TODO: Placeholder */
+			if (trace_path != NULL && Profiler_Init(trace_path))
+				Profiler_NameThread("Main");
+
+			if (measure_latency)
+				LatencyMeter_Init();
+
+			if (!(headless ? Video_InitHeadless(640, 480) : Video_Init(640, 480))) /* TODO: Placeholder */
 			{
 				PrintError("InitVideo failed");
 			}
@@ -414,13 +603,14 @@ int main(int argc, char **argv)
 				/*const char* const game_path = "OoTR_1509886_A1HZRRHPQN.z64";*/
 				const char* const game_path = "s1built.bin";
 			#elif defined(DYNAMIC_CORE)
-				const char* const core_path = argv[1];
-				const char* const game_path = argv[2];
+				const char* const core_path = arguments[0];
+				const char* const game_path = arguments[1];
 			#else
-				const char* const game_path = argv[1];
+				const char* const game_path = arguments[0];
 			#endif
 
-				audio_initialised = Audio_Init();
+				audio_initialised = headless ? Audio_InitNull(resample_audio) : Audio_Init();
+				Audio_SetLatencyBounds(minimum_audio_latency, maximum_audio_latency);
 
 				Menu_Init(Video_GetDPIScale());
 
@@ -434,10 +624,51 @@ int main(int argc, char **argv)
 				}
 				else
 				{
-					main_return = EXIT_SUCCESS;
+					if (record_movie_path != NULL && !CoreRunner_RecordMovie(record_movie_path))
+					{
+						PrintError("Could not start recording the movie");
+					}
+					else if (play_movie_path != NULL && !CoreRunner_PlayMovie(play_movie_path))
+					{
+						PrintError("Could not start playing the movie");
+					}
+					else
+					{
+						main_return = EXIT_SUCCESS;
+
+						/* Begin the mainloop */
+						if (headless)
+						{
+							Benchmark();
+						}
+						else
+						{
+							FramePacer_Statistics pacer_statistics;
+
+							paced_frames_per_second = frames_per_second;
+							FramePacer_Init(&frame_pacer, frames_per_second);
+
+							/* Whichever thread is running the core is the one that needs to skip frames. */
+							CoreRunner_SetFrameskip(allow_frameskip);
+							threaded = allow_threading && CoreRunner_StartThread();
+							FramePacer_SetFrameskip(&frame_pacer, allow_frameskip && !threaded);
+							/* The emulation thread does not present its own frames, so holding it back would not make them any fresher. */
+							FramePacer_SetFrameDelay(&frame_pacer, frame_delay && !threaded);
 
-					/* Begin the mainloop */
-					while (Iterate());
+							if (frame_delay && threaded)
+								PrintWarning("Frame delay cannot be used while the core is running on its own thread, so it has been disabled");
+
+							while (Iterate());
+
+							FramePacer_GetStatistics(&frame_pacer, &pacer_statistics);
+							PrintInfo("Frame pacing error: mean %.3fms, standard deviation %.3fms, maximum %.3fms, %lu of %lu frames missed, %lu skipped",
+								pacer_statistics.mean_error * 1000.0, pacer_statistics.standard_deviation * 1000.0, pacer_statistics.maximum_error * 1000.0,
+								pacer_statistics.total_missed_frames, pacer_statistics.total_frames + pacer_statistics.total_missed_frames, pacer_statistics.total_skipped_frames);
+
+							if (frame_delay && !threaded)
+								PrintInfo("Frame delay: %.3fms, %lu overruns", pacer_statistics.frame_delay * 1000.0, pacer_statistics.total_frame_delay_overruns);
+						}
+					}
 
 					CoreRunner_Deinit();
 				}
@@ -450,6 +681,10 @@ int main(int argc, char **argv)
 				Video_Deinit();
 			}
 
+			/* Everything that could have recorded zones has finished by now, so the trace can be written. */
+			Profiler_Deinit();
+			LatencyMeter_Deinit();
+
 			SDL_Quit();
 		}
 	}
@@ -209,3 +209,48 @@ void Menu_Draw(Menu *menu)
 			DrawOption(menu, menu->selected_option + 1, window_width / 2, window_height / 2 + option_spacing, &white);
 	}
 }
+
+/* Draws lines of text (separated by newlines) in the top-left corner of the screen, over a translucent background. */
+void Menu_DrawOverlay(const char* const text)
+{
+	Video_Rect rect;
+	const char *line;
+	size_t total_lines, maximum_line_width;
+
+	const Video_Colour black = {0, 0, 0};
+	const Font_Colour white = {0xFF, 0xFF, 0xFF};
+	const unsigned int line_height = DPI_SCALE(FONT_HEIGHT);
+	const unsigned int margin = DPI_SCALE(8);
+
+	/* Measure the text, so that the background fits it. */
+	total_lines = 0;
+	maximum_line_width = 0;
+
+	for (line = text; *line != '\0'; ++total_lines)
+	{
+		const char* const line_end = SDL_strchr(line, '\n');
+		const size_t line_length = line_end != NULL ? (size_t)(line_end - line) : SDL_strlen(line);
+		const size_t line_width = Font_GetTextWidth(&font, line, line_length, &font_callbacks);
+
+		maximum_line_width = SDL_max(maximum_line_width, line_width);
+		line += line_length + (line_end != NULL);
+	}
+
+	rect.x = 0;
+	rect.y = 0;
+	rect.width = maximum_line_width + margin * 2;
+	rect.height = total_lines * line_height + margin * 2;
+
+	Video_ColourFill(&rect, black, 0xA0);
+
+	total_lines = 0;
+
+	for (line = text; *line != '\0'; ++total_lines)
+	{
+		const char* const line_end = SDL_strchr(line, '\n');
+		const size_t line_length = line_end != NULL ? (size_t)(line_end - line) : SDL_strlen(line);
+
+		Font_DrawText(&font, margin, margin + total_lines * line_height, &white, line, line_length, &font_callbacks);
+		line += line_length + (line_end != NULL);
+	}
+}
@@ -50,3 +50,4 @@ void Menu_Destroy(Menu *menu);
 
 void Menu_Update(Menu *menu);
 void Menu_Draw(Menu *menu);
+void Menu_DrawOverlay(const char *text);
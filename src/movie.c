@@ -0,0 +1,253 @@
+#include "movie.h"
+
+#include <stddef.h>
+
+#include "SDL.h"
+
+#include "error.h"
+
+#define FORMAT_VERSION 1
+
+/* Every frame is stored as a bitfield of held buttons, a bitfield of which buttons have a non-zero analog value followed by those values, and then the analog sticks. */
+#define MAX_FRAME_SIZE (2 + 2 + CC_COUNT_OF(((Retropad*)NULL)->buttons) * 2 + CC_COUNT_OF(((Retropad*)NULL)->sticks) * 2 * 2)
+
+static const unsigned char magic[4] = {'C', 'L', 'M', 'V'};
+
+static SDL_RWops *file;
+
+static void WriteU16LE(unsigned char** const pointer, const unsigned int value)
+{
+	(*pointer)[0] = (value >> (8 * 0)) & 0xFF;
+	(*pointer)[1] = (value >> (8 * 1)) & 0xFF;
+	*pointer += 2;
+}
+
+static unsigned int ReadU16LE(const unsigned char** const pointer)
+{
+	const unsigned int value = (unsigned int)(*pointer)[0] << (8 * 0) | (unsigned int)(*pointer)[1] << (8 * 1);
+
+	*pointer += 2;
+
+	return value;
+}
+
+static short ReadS16LE(const unsigned char** const pointer)
+{
+	const unsigned int value = ReadU16LE(pointer);
+
+	/* Sign-extend without relying on implementation-defined conversions. */
+	return (short)((long)value - ((value & 0x8000) << 1));
+}
+
+static cc_bool WriteString(const char* const string)
+{
+	const size_t length = SDL_strlen(string);
+
+	return SDL_WriteLE32(file, (Uint32)length) == 1 && SDL_RWwrite(file, string, 1, length) == length;
+}
+
+static cc_bool StringMatches(const char* const string)
+{
+	cc_bool matches = cc_false;
+
+	const size_t length = SDL_ReadLE32(file);
+	char* const buffer = (char*)SDL_malloc(length);
+
+	if (buffer != NULL)
+	{
+		if (SDL_RWread(file, buffer, 1, length) == length)
+			matches = length == SDL_strlen(string) && SDL_memcmp(buffer, string, length) == 0;
+
+		SDL_free(buffer);
+	}
+
+	return matches;
+}
+
+/*************
+* Main stuff *
+*************/
+
+/* 64-bit FNV-1a, which is plenty to tell different games apart. */
+Uint64 Movie_Hash(const void* const data, const size_t size)
+{
+	const unsigned char* const bytes = (const unsigned char*)data;
+	Uint64 hash = 0xCBF29CE484222325;
+	size_t i;
+
+	for (i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3;
+	}
+
+	return hash;
+}
+
+cc_bool Movie_StartRecording(const char* const file_path, const Uint64 game_hash, const char* const core_path, const void* const state, const size_t state_size)
+{
+	file = SDL_RWFromFile(file_path, "wb");
+
+	if (file == NULL)
+	{
+		PrintError("Could not open movie file '%s' for writing", file_path);
+	}
+	else
+	{
+		if (SDL_RWwrite(file, magic, sizeof(magic), 1) != 1
+		 || SDL_WriteLE32(file, FORMAT_VERSION) != 1
+		 || SDL_WriteLE64(file, game_hash) != 1
+		 || !WriteString(core_path)
+		 || SDL_WriteLE32(file, (Uint32)state_size) != 1
+		 || (state_size != 0 && SDL_RWwrite(file, state, state_size, 1) != 1))
+		{
+			PrintError("Could not write movie header");
+		}
+		else
+		{
+			return cc_true;
+		}
+
+		SDL_RWclose(file);
+		file = NULL;
+	}
+
+	return cc_false;
+}
+
+/* On success, '*state' is the savestate to begin playback from (or NULL if there is not one), which the caller must free. */
+cc_bool Movie_StartPlayback(const char* const file_path, const Uint64 game_hash, const char* const core_path, unsigned char** const state, size_t* const state_size)
+{
+	file = SDL_RWFromFile(file_path, "rb");
+
+	if (file == NULL)
+	{
+		PrintError("Could not open movie file '%s'", file_path);
+	}
+	else
+	{
+		unsigned char file_magic[sizeof(magic)];
+
+		if (SDL_RWread(file, file_magic, sizeof(file_magic), 1) != 1 || SDL_memcmp(file_magic, magic, sizeof(magic)) != 0 || SDL_ReadLE32(file) != FORMAT_VERSION)
+		{
+			PrintError("'%s' is not a valid movie file", file_path);
+		}
+		else if (SDL_ReadLE64(file) != game_hash)
+		{
+			PrintError("Movie was recorded with a different game");
+		}
+		else
+		{
+			/* Cores can live in different places on different machines, so this is not worth failing over. */
+			if (!StringMatches(core_path))
+				PrintWarning("Movie was recorded with a different core");
+
+			*state_size = SDL_ReadLE32(file);
+			*state = NULL;
+
+			if (*state_size == 0)
+				return cc_true;
+
+			*state = (unsigned char*)SDL_malloc(*state_size);
+
+			if (*state == NULL)
+			{
+				PrintError("Could not allocate memory for the movie's savestate");
+			}
+			else
+			{
+				if (SDL_RWread(file, *state, *state_size, 1) == 1)
+					return cc_true;
+
+				PrintError("Could not read the movie's savestate");
+
+				SDL_free(*state);
+			}
+		}
+
+		SDL_RWclose(file);
+		file = NULL;
+	}
+
+	return cc_false;
+}
+
+void Movie_Stop(void)
+{
+	if (file != NULL)
+	{
+		SDL_RWclose(file);
+		file = NULL;
+	}
+}
+
+cc_bool Movie_WriteFrame(const Retropad* const input)
+{
+	unsigned char buffer[MAX_FRAME_SIZE];
+	unsigned char *pointer = buffer;
+	unsigned int held_buttons, analog_buttons;
+	size_t i;
+
+	held_buttons = analog_buttons = 0;
+
+	for (i = 0; i < CC_COUNT_OF(input->buttons); ++i)
+	{
+		held_buttons |= (input->buttons[i].held ? 1u : 0u) << i;
+		analog_buttons |= (input->buttons[i].axis != 0 ? 1u : 0u) << i;
+	}
+
+	WriteU16LE(&pointer, held_buttons);
+	WriteU16LE(&pointer, analog_buttons);
+
+	for (i = 0; i < CC_COUNT_OF(input->buttons); ++i)
+		if (input->buttons[i].axis != 0)
+			WriteU16LE(&pointer, (unsigned short)input->buttons[i].axis);
+
+	for (i = 0; i < CC_COUNT_OF(input->sticks); ++i)
+	{
+		WriteU16LE(&pointer, (unsigned short)input->sticks[i].axis[0]);
+		WriteU16LE(&pointer, (unsigned short)input->sticks[i].axis[1]);
+	}
+
+	return SDL_RWwrite(file, buffer, pointer - buffer, 1) == 1;
+}
+
+/* Returns false once the end of the movie has been reached. */
+cc_bool Movie_ReadFrame(Retropad* const input)
+{
+	unsigned char buffer[MAX_FRAME_SIZE];
+	const unsigned char *pointer = buffer;
+	unsigned int held_buttons, analog_buttons;
+	size_t total_analog_buttons, i;
+
+	if (SDL_RWread(file, buffer, 2 + 2, 1) != 1)
+		return cc_false;
+
+	held_buttons = ReadU16LE(&pointer);
+	analog_buttons = ReadU16LE(&pointer);
+
+	total_analog_buttons = 0;
+
+	for (i = 0; i < CC_COUNT_OF(input->buttons); ++i)
+		if ((analog_buttons & (1u << i)) != 0)
+			++total_analog_buttons;
+
+	if (SDL_RWread(file, &buffer[2 + 2], (total_analog_buttons + CC_COUNT_OF(input->sticks) * 2) * 2, 1) != 1)
+		return cc_false;
+
+	for (i = 0; i < CC_COUNT_OF(input->buttons); ++i)
+	{
+		/* 'pressed' is only used by the frontend's own hotkeys, so it is not recorded. */
+		input->buttons[i].pressed = cc_false;
+		input->buttons[i].held = (held_buttons & (1u << i)) != 0;
+		input->buttons[i].axis = (analog_buttons & (1u << i)) != 0 ? ReadS16LE(&pointer) : 0;
+	}
+
+	for (i = 0; i < CC_COUNT_OF(input->sticks); ++i)
+	{
+		input->sticks[i].axis[0] = ReadS16LE(&pointer);
+		input->sticks[i].axis[1] = ReadS16LE(&pointer);
+	}
+
+	return cc_true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "SDL.h"
+
+#include "clowncommon/clowncommon.h"
+
+#include "input.h"
+
+cc_bool Movie_StartRecording(const char *file_path, Uint64 game_hash, const char *core_path, const void *state, size_t state_size);
+cc_bool Movie_StartPlayback(const char *file_path, Uint64 game_hash, const char *core_path, unsigned char **state, size_t *state_size);
+void Movie_Stop(void);
+cc_bool Movie_WriteFrame(const Retropad *input);
+cc_bool Movie_ReadFrame(Retropad *input);
+Uint64 Movie_Hash(const void *data, size_t size);
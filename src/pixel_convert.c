@@ -0,0 +1,232 @@
+#include "pixel_convert.h"
+
+#include <stddef.h>
+
+#include "SDL.h"
+
+#include "clowncommon/clowncommon.h"
+
+#include "error.h"
+
+/* The vector kernels treat pixels as bytes in memory, which only lines up with the scalar kernels on little-endian CPUs. */
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#include <emmintrin.h>
+		#define PIXEL_CONVERT_SSE2
+
+		/* AVX2 cannot be assumed, so it is compiled separately and only used if the CPU turns out to support it. */
+		#if defined(__GNUC__) || defined(_MSC_VER)
+			#include <immintrin.h>
+			#define PIXEL_CONVERT_AVX2
+
+			#ifdef __GNUC__
+				#define AVX2_FUNCTION __attribute__((target("avx2")))
+			#else
+				#define AVX2_FUNCTION
+			#endif
+		#endif
+	#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		#include <arm_neon.h>
+		#define PIXEL_CONVERT_NEON
+	#endif
+#endif
+
+typedef void (*Kernel)(void *destination, const void *source, size_t total_pixels);
+
+typedef struct Kernels
+{
+	const char *name;
+	Kernel a8_to_rgba8888;
+} Kernels;
+
+/*****************
+* Scalar kernels *
+*****************/
+
+static void A8ToRGBA8888_Scalar(void* const destination, const void* const source, const size_t total_pixels)
+{
+	const unsigned char *input_pointer = (const unsigned char*)source;
+	unsigned char *output_pointer = (unsigned char*)destination;
+	size_t i;
+
+	for (i = 0; i < total_pixels; ++i)
+	{
+		*output_pointer++ = 0xFF;
+		*output_pointer++ = 0xFF;
+		*output_pointer++ = 0xFF;
+		*output_pointer++ = *input_pointer++;
+	}
+}
+
+static const Kernels scalar_kernels = {"scalar", A8ToRGBA8888_Scalar};
+
+/* Each vector kernel converts as many whole vectors as it can, and leaves the rest to the next-narrowest kernel. */
+
+/***************
+* SSE2 kernels *
+***************/
+
+#ifdef PIXEL_CONVERT_SSE2
+static void A8ToRGBA8888_SSE2(void* const destination, const void* const source, const size_t total_pixels)
+{
+	const unsigned char *input_pointer = (const unsigned char*)source;
+	unsigned char *output_pointer = (unsigned char*)destination;
+	const __m128i white = _mm_set1_epi8(-1);
+	size_t i;
+
+	/* Interleave the alpha with white twice: once to make 16-bit white-alpha pairs, and again to put white in front of those. */
+	for (i = 0; i < total_pixels / 16; ++i)
+	{
+		const __m128i alpha = _mm_loadu_si128((const __m128i*)input_pointer);
+		const __m128i low = _mm_unpacklo_epi8(white, alpha);
+		const __m128i high = _mm_unpackhi_epi8(white, alpha);
+
+		_mm_storeu_si128((__m128i*)&output_pointer[0x00], _mm_unpacklo_epi16(white, low));
+		_mm_storeu_si128((__m128i*)&output_pointer[0x10], _mm_unpackhi_epi16(white, low));
+		_mm_storeu_si128((__m128i*)&output_pointer[0x20], _mm_unpacklo_epi16(white, high));
+		_mm_storeu_si128((__m128i*)&output_pointer[0x30], _mm_unpackhi_epi16(white, high));
+
+		input_pointer += 16;
+		output_pointer += 16 * 4;
+	}
+
+	A8ToRGBA8888_Scalar(output_pointer, input_pointer, total_pixels % 16);
+}
+
+static const Kernels sse2_kernels = {"SSE2", A8ToRGBA8888_SSE2};
+#endif
+
+/***************
+* AVX2 kernels *
+***************/
+
+#ifdef PIXEL_CONVERT_AVX2
+AVX2_FUNCTION static void A8ToRGBA8888_AVX2(void* const destination, const void* const source, const size_t total_pixels)
+{
+	const unsigned char *input_pointer = (const unsigned char*)source;
+	unsigned char *output_pointer = (unsigned char*)destination;
+	const __m256i white = _mm256_set1_epi32(0x00FFFFFF);
+	size_t i;
+
+	/* Widen each alpha to 32 bits, and move it to the top byte. */
+	for (i = 0; i < total_pixels / 8; ++i)
+	{
+		const __m256i alpha = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)input_pointer));
+
+		_mm256_storeu_si256((__m256i*)output_pointer, _mm256_or_si256(_mm256_slli_epi32(alpha, 24), white));
+
+		input_pointer += 8;
+		output_pointer += 8 * 4;
+	}
+
+	A8ToRGBA8888_SSE2(output_pointer, input_pointer, total_pixels % 8);
+}
+
+static const Kernels avx2_kernels = {"AVX2", A8ToRGBA8888_AVX2};
+#endif
+
+/***************
+* NEON kernels *
+***************/
+
+#ifdef PIXEL_CONVERT_NEON
+static void A8ToRGBA8888_NEON(void* const destination, const void* const source, const size_t total_pixels)
+{
+	const unsigned char *input_pointer = (const unsigned char*)source;
+	unsigned char *output_pointer = (unsigned char*)destination;
+	uint8x16x4_t pixels;
+	size_t i;
+
+	pixels.val[0] = pixels.val[1] = pixels.val[2] = vdupq_n_u8(0xFF);
+
+	for (i = 0; i < total_pixels / 16; ++i)
+	{
+		pixels.val[3] = vld1q_u8(input_pointer);
+		vst4q_u8(output_pointer, pixels);
+
+		input_pointer += 16;
+		output_pointer += 16 * 4;
+	}
+
+	A8ToRGBA8888_Scalar(output_pointer, input_pointer, total_pixels % 16);
+}
+
+static const Kernels neon_kernels = {"NEON", A8ToRGBA8888_NEON};
+#endif
+
+static const Kernels *kernels = &scalar_kernels;
+
+#ifndef NDEBUG
+static cc_bool KernelMatchesScalar(const Kernel kernel, const Kernel scalar_kernel)
+{
+	/* Big enough for a few whole AVX2 vectors of the widest output. */
+	static unsigned char source[0x40 * 4];
+	static unsigned char expected[0x40 * 4], actual[0x40 * 4];
+
+	Uint32 random = 0x12345678;
+	size_t total_pixels, i;
+	cc_bool matches = cc_true;
+
+	for (i = 0; i < sizeof(source); ++i)
+	{
+		random = random * 1103515245 + 12345;
+		source[i] = (unsigned char)(random >> 16);
+	}
+
+	/* Try every length, so that the leftovers which do not fill a whole vector are checked too. */
+	for (total_pixels = 0; total_pixels <= 0x40; ++total_pixels)
+	{
+		SDL_memset(expected, 0, sizeof(expected));
+		SDL_memset(actual, 0, sizeof(actual));
+
+		scalar_kernel(expected, source, total_pixels);
+		kernel(actual, source, total_pixels);
+
+		if (SDL_memcmp(expected, actual, sizeof(expected)) != 0)
+			matches = cc_false;
+	}
+
+	return matches;
+}
+
+static cc_bool KernelsMatchScalar(const Kernels* const kernels)
+{
+	return KernelMatchesScalar(kernels->a8_to_rgba8888, scalar_kernels.a8_to_rgba8888);
+}
+#endif
+
+/*************
+* Main stuff *
+*************/
+
+void PixelConvert_Init(void)
+{
+	kernels = &scalar_kernels;
+
+#if defined(PIXEL_CONVERT_SSE2)
+	kernels = &sse2_kernels;
+#elif defined(PIXEL_CONVERT_NEON)
+	kernels = &neon_kernels;
+#endif
+
+#ifdef PIXEL_CONVERT_AVX2
+	if (SDL_HasAVX2())
+		kernels = &avx2_kernels;
+#endif
+
+#ifndef NDEBUG
+	/* Debug builds make sure that the vector kernels produce exactly what the scalar ones do. */
+	if (!KernelsMatchScalar(kernels))
+	{
+		PrintError("The %s pixel conversion kernels do not match the scalar ones, so the scalar ones will be used instead", kernels->name);
+		kernels = &scalar_kernels;
+	}
+#endif
+
+	PrintDebug("Using %s pixel conversion kernels", kernels->name);
+}
+
+void PixelConvert_A8ToRGBA8888(void* const destination, const void* const source, const size_t total_pixels)
+{
+	kernels->a8_to_rgba8888(destination, source, total_pixels);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stddef.h>
+
+void PixelConvert_Init(void);
+void PixelConvert_A8ToRGBA8888(void *destination, const void *source, size_t total_pixels);
@@ -0,0 +1,242 @@
+#include "profiler.h"
+
+#include <stddef.h>
+
+#include "SDL.h"
+
+#include "error.h"
+
+/* Each thread keeps the most recent zones that it has recorded, so that the trace covers the last few seconds or so. */
+#define TOTAL_EVENTS 0x10000
+#define MAX_DEPTH 16
+
+typedef struct Event
+{
+	const char *name;
+	Uint64 start_time, duration;
+} Event;
+
+/* Only the thread that owns one of these ever writes to it, so recording a zone does not need any locks. */
+typedef struct ThreadBuffer
+{
+	struct ThreadBuffer *next;
+	SDL_threadID thread_id;
+	const char *thread_name;
+
+	Event events[TOTAL_EVENTS];
+	size_t total_events;
+
+	struct
+	{
+		const char *name;
+		Uint64 start_time;
+	} stack[MAX_DEPTH];
+	unsigned int depth;
+} ThreadBuffer;
+
+static cc_bool enabled;
+static char *trace_file_path;
+static Uint64 start_time;
+static SDL_TLSID thread_buffer_id;
+
+/* New threads add their buffers to this list, which is only read once all of the threads have finished. */
+static SDL_SpinLock thread_buffers_lock;
+static ThreadBuffer *thread_buffers;
+
+static ThreadBuffer* GetThreadBuffer(void)
+{
+	ThreadBuffer *thread_buffer = (ThreadBuffer*)SDL_TLSGet(thread_buffer_id);
+
+	if (thread_buffer == NULL)
+	{
+		thread_buffer = (ThreadBuffer*)SDL_calloc(1, sizeof(ThreadBuffer));
+
+		if (thread_buffer != NULL)
+		{
+			thread_buffer->thread_id = SDL_ThreadID();
+
+			SDL_TLSSet(thread_buffer_id, thread_buffer, NULL);
+
+			SDL_AtomicLock(&thread_buffers_lock);
+			thread_buffer->next = thread_buffers;
+			thread_buffers = thread_buffer;
+			SDL_AtomicUnlock(&thread_buffers_lock);
+		}
+	}
+
+	return thread_buffer;
+}
+
+static cc_bool WriteString(SDL_RWops* const file, const char* const string)
+{
+	const size_t length = SDL_strlen(string);
+
+	return SDL_RWwrite(file, string, 1, length) == length;
+}
+
+static cc_bool WriteEvent(SDL_RWops* const file, const ThreadBuffer* const thread_buffer, const Event* const event, cc_bool* const first)
+{
+	char buffer[0x100];
+	const double ticks_per_microsecond = SDL_GetPerformanceFrequency() / 1000000.0;
+
+	SDL_snprintf(buffer, sizeof(buffer), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+		*first ? "" : ",\n", event->name, (unsigned long)thread_buffer->thread_id,
+		(event->start_time - start_time) / ticks_per_microsecond, event->duration / ticks_per_microsecond);
+
+	*first = cc_false;
+
+	return WriteString(file, buffer);
+}
+
+/* Writes everything out in the Trace Event Format, which can be opened with Perfetto or chrome://tracing. */
+static cc_bool WriteTrace(const char* const file_path)
+{
+	cc_bool success = cc_false;
+
+	SDL_RWops* const file = SDL_RWFromFile(file_path, "wb");
+
+	if (file != NULL)
+	{
+		const ThreadBuffer *thread_buffer;
+		cc_bool first = cc_true;
+
+		success = WriteString(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+		for (thread_buffer = thread_buffers; thread_buffer != NULL; thread_buffer = thread_buffer->next)
+		{
+			/* The buffer may have wrapped around, in which case the oldest event is the one after the newest. */
+			const size_t total_events = SDL_min(thread_buffer->total_events, TOTAL_EVENTS);
+			const size_t first_event = thread_buffer->total_events - total_events;
+			size_t i;
+
+			if (thread_buffer->thread_name != NULL)
+			{
+				char buffer[0x100];
+
+				SDL_snprintf(buffer, sizeof(buffer), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+					first ? "" : ",\n", (unsigned long)thread_buffer->thread_id, thread_buffer->thread_name);
+
+				first = cc_false;
+
+				success &= WriteString(file, buffer);
+			}
+
+			for (i = first_event; i < thread_buffer->total_events; ++i)
+				success &= WriteEvent(file, thread_buffer, &thread_buffer->events[i % TOTAL_EVENTS], &first);
+		}
+
+		success &= WriteString(file, "\n]}\n");
+
+		SDL_RWclose(file);
+	}
+
+	return success;
+}
+
+/*************
+* Main stuff *
+*************/
+
+cc_bool Profiler_Init(const char* const file_path)
+{
+	thread_buffer_id = SDL_TLSCreate();
+
+	if (thread_buffer_id == 0)
+	{
+		PrintError("SDL_TLSCreate failed - Error: '%s'", SDL_GetError());
+	}
+	else
+	{
+		trace_file_path = SDL_strdup(file_path);
+
+		if (trace_file_path == NULL)
+		{
+			PrintError("Could not allocate memory for the trace file path");
+		}
+		else
+		{
+			start_time = SDL_GetPerformanceCounter();
+			enabled = cc_true;
+		}
+	}
+
+	return enabled;
+}
+
+/* Must only be called once every other thread that recorded zones has finished. */
+void Profiler_Deinit(void)
+{
+	if (enabled)
+	{
+		enabled = cc_false;
+
+		if (WriteTrace(trace_file_path))
+			PrintInfo("Trace written to '%s'", trace_file_path);
+		else
+			PrintError("Could not write trace to '%s'", trace_file_path);
+
+		while (thread_buffers != NULL)
+		{
+			ThreadBuffer* const next = thread_buffers->next;
+
+			SDL_free(thread_buffers);
+			thread_buffers = next;
+		}
+
+		SDL_free(trace_file_path);
+	}
+}
+
+void Profiler_NameThread(const char* const name)
+{
+	if (enabled)
+	{
+		ThreadBuffer* const thread_buffer = GetThreadBuffer();
+
+		if (thread_buffer != NULL)
+			thread_buffer->thread_name = name;
+	}
+}
+
+/* 'name' must outlive the profiler, so it should be a string literal. */
+void Profiler_Begin(const char* const name)
+{
+	if (enabled)
+	{
+		ThreadBuffer* const thread_buffer = GetThreadBuffer();
+
+		if (thread_buffer != NULL)
+		{
+			/* Zones that are nested too deeply are still counted, so that they are matched up with their 'Profiler_End' calls, but they are not recorded. */
+			if (thread_buffer->depth < MAX_DEPTH)
+			{
+				thread_buffer->stack[thread_buffer->depth].name = name;
+				thread_buffer->stack[thread_buffer->depth].start_time = SDL_GetPerformanceCounter();
+			}
+
+			++thread_buffer->depth;
+		}
+	}
+}
+
+void Profiler_End(void)
+{
+	if (enabled)
+	{
+		ThreadBuffer* const thread_buffer = GetThreadBuffer();
+
+		if (thread_buffer != NULL && thread_buffer->depth != 0)
+		{
+			--thread_buffer->depth;
+
+			if (thread_buffer->depth < MAX_DEPTH)
+			{
+				Event* const event = &thread_buffer->events[thread_buffer->total_events++ % TOTAL_EVENTS];
+
+				event->name = thread_buffer->stack[thread_buffer->depth].name;
+				event->start_time = thread_buffer->stack[thread_buffer->depth].start_time;
+				event->duration = SDL_GetPerformanceCounter() - event->start_time;
+			}
+		}
+	}
+}
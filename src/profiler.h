@@ -0,0 +1,9 @@
+#pragma once
+
+#include "clowncommon/clowncommon.h"
+
+cc_bool Profiler_Init(const char *file_path);
+void Profiler_Deinit(void);
+void Profiler_NameThread(const char *name);
+void Profiler_Begin(const char *name);
+void Profiler_End(void);
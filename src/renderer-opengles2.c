@@ -10,6 +10,17 @@
 #define VERTEX_ATTRIBUTE_TEXTURE_COORDINATES 1
 #define VERTEX_ATTRIBUTE_COLOUR 2
 
+/* Textures are uploaded exactly as the core provides them, so each format has its own program to turn its texels into colours. */
+typedef enum Decoder
+{
+	DECODER_RGBA,     /* The texel is already correct. */
+	DECODER_RGBX,     /* The texel is correct, but its alpha is junk. */
+	DECODER_BGRX,     /* Raw XRGB8888 uploaded as bytes, where red and blue are swapped and the alpha is junk. */
+	DECODER_0RGB1555, /* Raw 0RGB1555 uploaded as luminance-alpha, where each channel holds one byte of the pixel. */
+	DECODER_ALPHA,    /* An alpha-only texture, which is white. */
+	TOTAL_DECODERS
+} Decoder;
+
 typedef struct Vertex
 {
 	GLfloat position[2];
@@ -24,7 +35,11 @@ static SDL_GLContext context;
 
 static Renderer_Texture colour_fill_texture;
 
-static GLuint program;
+static GLuint programs[TOTAL_DECODERS];
+static GLuint current_program;
+
+/* Whether rows can be uploaded with padding between them, which OpenGL ES 2.0 needs an extension for. */
+static cc_bool unpack_row_length_supported;
 #ifndef RENDERER_OPENGLES2
 static GLuint vertex_array_object;
 #endif
@@ -161,6 +176,93 @@ static GLuint CompileProgram(const GLchar* const vertex_shader_source, const GLc
 	return 0;
 }
 
+static void DeletePrograms(void)
+{
+	size_t i;
+
+	for (i = 0; i < CC_COUNT_OF(programs); ++i)
+	{
+		glDeleteProgram(programs[i]);
+		programs[i] = 0;
+	}
+}
+
+static cc_bool CompilePrograms(void)
+{
+	/* TODO: Make these compatible with Desktop OpenGL. */
+	static const GLchar vertex_shader_source[] = " \
+		#version 100\n \
+		attribute vec2 input_vertex_coordinates; \
+		attribute vec2 input_texture_coordinates; \
+		attribute vec4 input_colour; \
+		varying vec2 texture_coordinates; \
+		varying vec4 colour; \
+		void main() \
+		{ \
+			gl_Position = vec4(input_vertex_coordinates.xy, 0.0, 1.0); \
+			texture_coordinates = input_texture_coordinates; \
+			colour = input_colour; \
+		} \
+	";
+
+#define FRAGMENT_SHADER_SOURCE(DECODE) " \
+		#version 100\n \
+		precision mediump float; \
+		varying vec2 texture_coordinates; \
+		varying vec4 colour; \
+		uniform sampler2D sampler; \
+		vec4 Decode(vec4 texel) \
+		{ \
+			" DECODE " \
+		} \
+		void main() \
+		{ \
+			gl_FragColor = Decode(texture2D(sampler, texture_coordinates)) * colour; \
+		} \
+	"
+
+	static const GLchar* const fragment_shader_sources[TOTAL_DECODERS] = {
+		/* DECODER_RGBA */
+		FRAGMENT_SHADER_SOURCE("return texel;"),
+		/* DECODER_RGBX */
+		FRAGMENT_SHADER_SOURCE("return vec4(texel.rgb, 1.0);"),
+		/* DECODER_BGRX */
+		FRAGMENT_SHADER_SOURCE("return vec4(texel.bgr, 1.0);"),
+		/* DECODER_0RGB1555 */
+		/* The pixel is put back together from its two bytes one channel at a time, as 'mediump' is not precise enough to hold the whole thing. */
+		FRAGMENT_SHADER_SOURCE(" \
+			vec2 bytes = floor(texel.ra * 255.0 + 0.5); \
+			float red = mod(floor(bytes.y / 4.0), 32.0); \
+			float green = mod(bytes.y, 4.0) * 8.0 + floor(bytes.x / 32.0); \
+			float blue = mod(bytes.x, 32.0); \
+			return vec4(vec3(red, green, blue) / 31.0, 1.0); \
+		"),
+		/* DECODER_ALPHA */
+	#ifdef RENDERER_OPENGLES2
+		FRAGMENT_SHADER_SOURCE("return vec4(1.0, 1.0, 1.0, texel.a);")
+	#else
+		FRAGMENT_SHADER_SOURCE("return vec4(1.0, 1.0, 1.0, texel.r);")
+	#endif
+	};
+
+#undef FRAGMENT_SHADER_SOURCE
+
+	size_t i;
+
+	for (i = 0; i < CC_COUNT_OF(programs); ++i)
+	{
+		programs[i] = CompileProgram(vertex_shader_source, fragment_shader_sources[i]);
+
+		if (programs[i] == 0)
+		{
+			DeletePrograms();
+			return cc_false;
+		}
+	}
+
+	return cc_true;
+}
+
 /*************
 * Main stuff *
 *************/
@@ -201,39 +303,17 @@ SDL_Window* Renderer_Init(const char* const window_name, const size_t window_wid
 		}
 		else
 		{
-			/* TODO: Make these compatible with Desktop OpenGL. */
-			static const GLchar vertex_shader_source[] = " \
-				#version 100\n \
-				attribute vec2 input_vertex_coordinates; \
-				attribute vec2 input_texture_coordinates; \
-				attribute vec4 input_colour; \
-				varying vec2 texture_coordinates; \
-				varying vec4 colour; \
-				void main() \
-				{ \
-					gl_Position = vec4(input_vertex_coordinates.xy, 0.0, 1.0); \
-					texture_coordinates = input_texture_coordinates; \
-					colour = input_colour; \
-				} \
-			";
-
-			static const GLchar fragment_shader_source[] = " \
-				#version 100\n \
-				precision mediump float; \
-				varying vec2 texture_coordinates; \
-				varying vec4 colour; \
-				uniform sampler2D sampler; \
-				void main() \
-				{ \
-					gl_FragColor = texture2D(sampler, texture_coordinates) * colour, 1.0; \
-				} \
-			";
-
 		#ifdef RENDERER_OPENGLES2
 			gladLoadGLES2Loader(SDL_GL_GetProcAddress);
 		#else
 			gladLoadGLLoader(SDL_GL_GetProcAddress);
 		#endif
+		#ifdef RENDERER_OPENGLES2
+			unpack_row_length_supported = SDL_GL_ExtensionSupported("GL_EXT_unpack_subimage");
+		#else
+			unpack_row_length_supported = cc_true;
+		#endif
+
 		#ifndef NDEBUG
 			if (GLAD_GL_KHR_debug)
 			{
@@ -243,11 +323,9 @@ SDL_Window* Renderer_Init(const char* const window_name, const size_t window_wid
 			}
 		#endif
 
-			program = CompileProgram(vertex_shader_source, fragment_shader_source);
-
-			if (program == 0)
+			if (!CompilePrograms())
 			{
-				PrintError("CompileProgram failed");
+				PrintError("CompilePrograms failed");
 			}
 			else
 			{
@@ -277,7 +355,7 @@ SDL_Window* Renderer_Init(const char* const window_name, const size_t window_wid
 			#ifndef RENDERER_OPENGLES2
 				glDeleteVertexArrays(1, &vertex_array_object);
 			#endif
-				glDeleteProgram(program);
+				DeletePrograms();
 			}
 
 			SDL_GL_DeleteContext(context);
@@ -297,7 +375,7 @@ void Renderer_Deinit(void)
 #ifndef RENDERER_OPENGLES2
 	glDeleteVertexArrays(1, &vertex_array_object);
 #endif
-	glDeleteProgram(program);
+	DeletePrograms();
 
 	SDL_GL_DeleteContext(context);
 }
@@ -309,7 +387,8 @@ void Renderer_Clear(void)
 
 	glActiveTexture(GL_TEXTURE0);
 
-	glUseProgram(program);
+	/* The program is bound when something is drawn, as each texture format has its own. */
+	current_program = 0;
 
 #ifndef RENDERER_OPENGLES2
 	glBindVertexArray(vertex_array_object);
@@ -363,26 +442,65 @@ static unsigned int BytesPerPixel(const Renderer_Format format)
 		/*format == VIDEO_FORMAT_A8 ?*/ 1;
 }
 
+/* OpenGL ES 2.0 lacks the packed formats that match the core's pixels, so it is handed their raw bytes instead, and the program sorts them out. */
 static GLenum TextureFormat(const Renderer_Format format)
 {
 	return
-		format == VIDEO_FORMAT_0RGB1555 ? GL_RGBA :
+#ifdef RENDERER_OPENGLES2
+		format == VIDEO_FORMAT_0RGB1555 ? GL_LUMINANCE_ALPHA :
 		format == VIDEO_FORMAT_XRGB8888 ? GL_RGBA :
 		format == VIDEO_FORMAT_RGB565 ? GL_RGB :
-#ifdef RENDERER_OPENGLES2
-		/*format == VIDEO_FORMAT_A8 ?*/ GL_LUMINANCE_ALPHA;
+		/*format == VIDEO_FORMAT_A8 ?*/ GL_ALPHA;
 #else
-		/*format == VIDEO_FORMAT_A8 ?*/ GL_RGBA;
+		format == VIDEO_FORMAT_0RGB1555 ? GL_BGRA :
+		format == VIDEO_FORMAT_XRGB8888 ? GL_BGRA :
+		format == VIDEO_FORMAT_RGB565 ? GL_RGB :
+		/*format == VIDEO_FORMAT_A8 ?*/ GL_RED;
 #endif
 }
 
 static GLenum TextureType(const Renderer_Format format)
 {
 	return
-		format == VIDEO_FORMAT_0RGB1555 ? GL_UNSIGNED_SHORT_5_5_5_1 :
+#ifdef RENDERER_OPENGLES2
+		format == VIDEO_FORMAT_0RGB1555 ? GL_UNSIGNED_BYTE :
 		format == VIDEO_FORMAT_XRGB8888 ? GL_UNSIGNED_BYTE :
 		format == VIDEO_FORMAT_RGB565 ? GL_UNSIGNED_SHORT_5_6_5 :
 		/*format == VIDEO_FORMAT_A8 ?*/ GL_UNSIGNED_BYTE;
+#else
+		format == VIDEO_FORMAT_0RGB1555 ? GL_UNSIGNED_SHORT_1_5_5_5_REV :
+		format == VIDEO_FORMAT_XRGB8888 ? GL_UNSIGNED_INT_8_8_8_8_REV :
+		format == VIDEO_FORMAT_RGB565 ? GL_UNSIGNED_SHORT_5_6_5 :
+		/*format == VIDEO_FORMAT_A8 ?*/ GL_UNSIGNED_BYTE;
+#endif
+}
+
+static GLint TextureInternalFormat(const Renderer_Format format)
+{
+#ifdef RENDERER_OPENGLES2
+	/* OpenGL ES 2.0 requires these to match. */
+	return TextureFormat(format);
+#else
+	return
+		format == VIDEO_FORMAT_0RGB1555 ? GL_RGB5_A1 :
+		format == VIDEO_FORMAT_XRGB8888 ? GL_RGBA8 :
+		format == VIDEO_FORMAT_RGB565 ? GL_RGB :
+		/*format == VIDEO_FORMAT_A8 ?*/ GL_R8;
+#endif
+}
+
+static Decoder TextureDecoder(const Renderer_Format format)
+{
+	return
+#ifdef RENDERER_OPENGLES2
+		format == VIDEO_FORMAT_0RGB1555 ? DECODER_0RGB1555 :
+		format == VIDEO_FORMAT_XRGB8888 ? DECODER_BGRX :
+#else
+		format == VIDEO_FORMAT_0RGB1555 ? DECODER_RGBX :
+		format == VIDEO_FORMAT_XRGB8888 ? DECODER_RGBX :
+#endif
+		format == VIDEO_FORMAT_RGB565 ? DECODER_RGBA :
+		/*format == VIDEO_FORMAT_A8 ?*/ DECODER_ALPHA;
 }
 
 cc_bool Renderer_TextureCreate(Renderer_Texture *texture, size_t width, size_t height, Renderer_Format format, cc_bool streaming)
@@ -394,16 +512,40 @@ cc_bool Renderer_TextureCreate(Renderer_Texture *texture, size_t width, size_t h
 	texture->format = format;
 	texture->width = width;
 	texture->height = height;
+	texture->program = programs[TextureDecoder(format)];
+	texture->lock_buffer = NULL;
+#ifndef RENDERER_OPENGLES2
+	SDL_zero(texture->pixel_buffers);
+	SDL_zero(texture->pixel_buffer_fences);
+	texture->pixel_buffer_index = 0;
+	texture->pixel_buffer_mapped = cc_false;
+#endif
 
 	glGenTextures(1, &texture->id);
 
 	glBindTexture(GL_TEXTURE_2D, texture->id);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexImage2D(GL_TEXTURE_2D, 0, opengl_format, width, height, 0, opengl_format, opengl_type, NULL);
+	glTexImage2D(GL_TEXTURE_2D, 0, TextureInternalFormat(format), width, height, 0, opengl_format, opengl_type, NULL);
 
 	if (streaming)
 	{
+	#ifndef RENDERER_OPENGLES2
+		size_t i;
+
+		/* Streaming textures are uploaded through a ring of pixel buffers, so that the next frame can be written while the GPU is still reading the last one. */
+		glGenBuffers(CC_COUNT_OF(texture->pixel_buffers), texture->pixel_buffers);
+
+		for (i = 0; i < CC_COUNT_OF(texture->pixel_buffers); ++i)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pixel_buffers[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, width * height * bytes_per_pixel, NULL, GL_STREAM_DRAW);
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	#endif
+
+		/* This is still needed for when a pixel buffer cannot be mapped. */
 		texture->lock_buffer = (unsigned char*)SDL_malloc(width * height * bytes_per_pixel);
 
 		return texture->lock_buffer != NULL;
@@ -416,84 +558,122 @@ cc_bool Renderer_TextureCreate(Renderer_Texture *texture, size_t width, size_t h
 
 void Renderer_TextureDestroy(Renderer_Texture *texture)
 {
+#ifndef RENDERER_OPENGLES2
+	size_t i;
+
+	for (i = 0; i < CC_COUNT_OF(texture->pixel_buffer_fences); ++i)
+		glDeleteSync(texture->pixel_buffer_fences[i]);
+
+	glDeleteBuffers(CC_COUNT_OF(texture->pixel_buffers), texture->pixel_buffers);
+#endif
+
 	SDL_free(texture->lock_buffer);
 	glDeleteTextures(1, &texture->id);
 }
 
 void Renderer_TextureUpdate(Renderer_Texture *texture, const void *pixels, const Renderer_Rect *rect)
+{
+	Renderer_TextureUpdatePitched(texture, pixels, rect, rect->width * BytesPerPixel(texture->format));
+}
+
+void Renderer_TextureUpdatePitched(Renderer_Texture *texture, const void *pixels, const Renderer_Rect *rect, size_t pitch)
 {
 	const GLint alignments[8] = {8, 1, 2, 1, 4, 1, 2, 1};
+	const unsigned int bytes_per_pixel = BytesPerPixel(texture->format);
+	const GLenum format = TextureFormat(texture->format);
+	const GLenum type = TextureType(texture->format);
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, alignments[rect->width % CC_COUNT_OF(alignments)]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignments[pitch % CC_COUNT_OF(alignments)]);
 	glBindTexture(GL_TEXTURE_2D, texture->id);
 
-	if (texture->format == VIDEO_FORMAT_A8 || texture->format == VIDEO_FORMAT_XRGB8888 || texture->format == VIDEO_FORMAT_0RGB1555)
+	if (pitch == rect->width * bytes_per_pixel || rect->height == 1)
 	{
-		const unsigned int bytes_per_pixel =
-			texture->format == VIDEO_FORMAT_0RGB1555 ? 2 :
-			texture->format == VIDEO_FORMAT_XRGB8888 ? 4 :
-			texture->format == VIDEO_FORMAT_RGB565 ? 2 :
-#ifdef RENDERER_OPENGLES2
-			/*texture->format == VIDEO_FORMAT_A8 ?*/ 2;
-#else
-			/*texture->format == VIDEO_FORMAT_A8 ?*/ 4;
-#endif
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x, rect->y, rect->width, rect->height, format, type, pixels);
+	}
+	else if (unpack_row_length_supported && pitch % bytes_per_pixel == 0)
+	{
+		/* Have OpenGL skip the padding at the end of each row itself. */
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / bytes_per_pixel);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x, rect->y, rect->width, rect->height, format, type, pixels);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+	else if (texture->lock_buffer != NULL)
+	{
+		const unsigned char* const source_pixels = (const unsigned char*)pixels;
+		const size_t row_size = rect->width * bytes_per_pixel;
+		size_t y;
 
-		void *converted_pixels = SDL_malloc(rect->width * rect->height * bytes_per_pixel);
+		/* Without a way to skip the padding, repack the rows into the lock buffer so that they can still be uploaded all at once. */
+		for (y = 0; y < rect->height; ++y)
+			SDL_memcpy(&texture->lock_buffer[row_size * y], &source_pixels[pitch * y], row_size);
 
-		if (converted_pixels != NULL)
-		{
-			size_t i;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignments[row_size % CC_COUNT_OF(alignments)]);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x, rect->y, rect->width, rect->height, format, type, texture->lock_buffer);
+	}
+	else
+	{
+		const unsigned char* const row_pixels = (const unsigned char*)pixels;
+		size_t y;
 
-			if (texture->format == VIDEO_FORMAT_A8)
-			{
-				const unsigned char *input_pointer = (const unsigned char*)pixels;
-				unsigned char *output_pointer = (unsigned char*)converted_pixels;
+		/* Only streaming textures have a lock buffer, and nothing uploads padded pixels to any other kind, so this is just a last resort. */
+		for (y = 0; y < rect->height; ++y)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x, rect->y + y, rect->width, 1, format, type, &row_pixels[pitch * y]);
+	}
+}
 
-				for (i = 0; i < rect->width * rect->height; ++i)
-				{
 #ifndef RENDERER_OPENGLES2
-					*output_pointer++ = 0xFF;
-					*output_pointer++ = 0xFF;
-#endif
-					*output_pointer++ = 0xFF;
-					*output_pointer++ = *input_pointer++;
-				}
-			}
-			else if (texture->format == VIDEO_FORMAT_XRGB8888)
-			{
-				/* TODO: Use native texture type in Desktop OpenGL to avoid this. */
-				const GLuint *input_pointer = (const GLuint*)pixels;
-				unsigned char *output_pointer = (unsigned char*)converted_pixels;
-
-				for (i = 0; i < rect->width * rect->height; ++i)
-				{
-					const GLuint pixel = *input_pointer++;
-					*output_pointer++ = (pixel >> 8 * 2) & 0xFF;
-					*output_pointer++ = (pixel >> 8 * 1) & 0xFF;
-					*output_pointer++ = (pixel >> 8 * 0) & 0xFF;
-					*output_pointer++ = (pixel >> 8 * 3) & 0xFF;
-				}
-			}
-			else if (texture->format == VIDEO_FORMAT_0RGB1555)
-			{
-				const GLushort *input_pointer = (const GLushort*)pixels;
-				GLushort *output_pointer = (GLushort*)converted_pixels;
+static unsigned char* MapPixelBuffer(Renderer_Texture* const texture, const size_t size)
+{
+	const unsigned int index = texture->pixel_buffer_index;
+	GLsync* const fence = &texture->pixel_buffer_fences[index];
 
-				for (i = 0; i < rect->width * rect->height; ++i)
-					*output_pointer++ = (*input_pointer++ << 1) | 1;
-			}
+	unsigned char *buffer = NULL;
 
-			glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x, rect->y, rect->width, rect->height, TextureFormat(texture->format), TextureType(texture->format), converted_pixels);
+	/* The buffer is mapped unsynchronised, so make sure that the GPU has finished uploading from it the last time around. */
+	/* This should only ever wait if the GPU has fallen a whole ring behind, and a second is plenty for that. */
+	if (*fence != NULL)
+	{
+		const GLenum result = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
 
-			SDL_free(converted_pixels);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+		{
+			glDeleteSync(*fence);
+			*fence = NULL;
 		}
 	}
-	else
+
+	if (texture->pixel_buffers[index] != 0 && *fence == NULL)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pixel_buffers[index]);
+		buffer = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	texture->pixel_buffer_mapped = buffer != NULL;
+
+	return buffer;
+}
+
+static void UnmapPixelBuffer(Renderer_Texture* const texture)
+{
+	const unsigned int index = texture->pixel_buffer_index;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pixel_buffers[index]);
+
+	/* If the buffer's contents were lost while it was mapped, then there is nothing worth uploading. */
+	if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE)
 	{
-		glTexSubImage2D(GL_TEXTURE_2D, 0, rect->x, rect->y, rect->width, rect->height, TextureFormat(texture->format), TextureType(texture->format), pixels);
+		/* With a pixel buffer bound, the 'pixels' pointer is an offset into it instead. */
+		Renderer_TextureUpdate(texture, NULL, &texture->lock_rect);
+		texture->pixel_buffer_fences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	texture->pixel_buffer_index = (index + 1) % CC_COUNT_OF(texture->pixel_buffers);
+	texture->pixel_buffer_mapped = cc_false;
 }
+#endif
 
 cc_bool Renderer_TextureLock(Renderer_Texture *texture, const Renderer_Rect *rect, unsigned char **buffer, size_t *pitch)
 {
@@ -502,7 +682,13 @@ cc_bool Renderer_TextureLock(Renderer_Texture *texture, const Renderer_Rect *rec
 	if (texture->lock_buffer == NULL)
 		return cc_false;
 
-	*buffer = texture->lock_buffer;
+#ifndef RENDERER_OPENGLES2
+	*buffer = MapPixelBuffer(texture, rect->width * rect->height * bytes_per_pixel);
+
+	if (*buffer == NULL)
+#endif
+		*buffer = texture->lock_buffer;
+
 	*pitch = rect->width * bytes_per_pixel;
 	texture->lock_rect = *rect;
 
@@ -511,7 +697,34 @@ cc_bool Renderer_TextureLock(Renderer_Texture *texture, const Renderer_Rect *rec
 
 void Renderer_TextureUnlock(Renderer_Texture *texture)
 {
-	Renderer_TextureUpdate(texture, texture->lock_buffer, &texture->lock_rect);
+#ifndef RENDERER_OPENGLES2
+	if (texture->pixel_buffer_mapped)
+		UnmapPixelBuffer(texture);
+	else
+#endif
+		Renderer_TextureUpdate(texture, texture->lock_buffer, &texture->lock_rect);
+}
+
+void Renderer_TextureAbandonLock(Renderer_Texture *texture)
+{
+#ifndef RENDERER_OPENGLES2
+	/* The buffer's contents are unwanted, so just give it back without uploading from it. */
+	if (texture->pixel_buffer_mapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture->pixel_buffers[texture->pixel_buffer_index]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		texture->pixel_buffer_mapped = cc_false;
+	}
+#else
+	(void)texture;
+#endif
+}
+
+cc_bool Renderer_TextureCanAbandonLock(void)
+{
+	return cc_true;
 }
 
 static void Renderer_TextureDrawAlpha(Renderer_Texture *texture, const Renderer_Rect *dst_rect, const Renderer_Rect *src_rect, Renderer_Colour colour, const unsigned char alpha)
@@ -540,6 +753,12 @@ static void Renderer_TextureDrawAlpha(Renderer_Texture *texture, const Renderer_
 	else
 		glDisable(GL_BLEND);
 
+	if (current_program != texture->program)
+	{
+		current_program = texture->program;
+		glUseProgram(current_program);
+	}
+
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STREAM_DRAW);
 	glBindTexture(GL_TEXTURE_2D, texture->id);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, CC_COUNT_OF(vertices));
@@ -592,6 +811,9 @@ cc_bool Renderer_FramebufferCreateHardware(Renderer_Framebuffer* const framebuff
 	PrintDebug("width %u height %u", (unsigned int)width, (unsigned int)height); /* TODO: Remove this */
 	if (Renderer_TextureCreate(&framebuffer->texture, width, height, VIDEO_FORMAT_XRGB8888, cc_false))
 	{
+		/* The core renders proper RGBA into this, rather than handing over XRGB8888 pixels. */
+		framebuffer->texture.program = programs[DECODER_RGBA];
+
 		framebuffer->depth_renderbuffer_id = 0;
 		framebuffer->stencil_renderbuffer_id = 0;
 
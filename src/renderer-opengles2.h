@@ -2,14 +2,22 @@
 
 #include <glad/glad.h>
 
+#define RENDERER_TOTAL_PIXEL_BUFFERS 3
+
 typedef struct Renderer_Texture
 {
 	GLuint id;
+	GLuint program;
 	Renderer_Format format;
 	unsigned char *lock_buffer;
 	size_t width, height;
 	Renderer_Rect lock_rect;
-	unsigned char *convert_buffer;
+#ifndef RENDERER_OPENGLES2
+	GLuint pixel_buffers[RENDERER_TOTAL_PIXEL_BUFFERS];
+	GLsync pixel_buffer_fences[RENDERER_TOTAL_PIXEL_BUFFERS];
+	unsigned int pixel_buffer_index;
+	cc_bool pixel_buffer_mapped;
+#endif
 } Renderer_Texture;
 
 typedef struct Renderer_Framebuffer
@@ -21,5 +29,4 @@ typedef struct Renderer_Framebuffer
 	unsigned char *lock_buffer;
 	size_t width, height;
 	Renderer_Rect lock_rect;
-	unsigned char *convert_buffer;
 } Renderer_Framebuffer;
@@ -4,6 +4,8 @@
 
 #include "SDL.h"
 
+#include "pixel_convert.h"
+
 static SDL_Renderer *renderer;
 
 /*************
@@ -16,6 +18,8 @@ SDL_Window* Renderer_Init(const char* const window_name, const size_t window_wid
 
 	if (window != NULL)
 	{
+		PixelConvert_Init();
+
 		renderer = SDL_CreateRenderer(window, -1, 0);
 
 		if (renderer != NULL)
@@ -76,6 +80,13 @@ void Renderer_TextureDestroy(Renderer_Texture *texture)
 }
 
 void Renderer_TextureUpdate(Renderer_Texture *texture, const void *pixels, const Renderer_Rect *rect)
+{
+	static const unsigned int sizes[] = {2, 4, 2, 1};
+
+	Renderer_TextureUpdatePitched(texture, pixels, rect, rect->width * sizes[texture->format]);
+}
+
+void Renderer_TextureUpdatePitched(Renderer_Texture *texture, const void *pixels, const Renderer_Rect *rect, size_t pitch)
 {
 	SDL_Rect sdl_rect;
 
@@ -92,21 +103,8 @@ void Renderer_TextureUpdate(Renderer_Texture *texture, const void *pixels, const
 		{
 			size_t y;
 
-			unsigned char *rgba_pointer = rgba_pixels;
-			const unsigned char *pixels_pointer = (const unsigned char*)pixels;
-
 			for (y = 0; y < rect->height; ++y)
-			{
-				size_t x;
-
-				for (x = 0; x < rect->width; ++x)
-				{
-					*rgba_pointer++ = 0xFF;
-					*rgba_pointer++ = 0xFF;
-					*rgba_pointer++ = 0xFF;
-					*rgba_pointer++ = *pixels_pointer++;
-				}
-			}
+				PixelConvert_A8ToRGBA8888(&rgba_pixels[rect->width * 4 * y], &((const unsigned char*)pixels)[pitch * y], rect->width);
 
 			SDL_UpdateTexture(texture->sdl_texture, &sdl_rect, rgba_pixels, rect->width * 4);
 
@@ -115,9 +113,7 @@ void Renderer_TextureUpdate(Renderer_Texture *texture, const void *pixels, const
 	}
 	else
 	{
-		static const unsigned int sizes[] = {2, 4, 2, 4};
-
-		SDL_UpdateTexture(texture->sdl_texture, &sdl_rect, pixels, rect->width * sizes[texture->format]);
+		SDL_UpdateTexture(texture->sdl_texture, &sdl_rect, pixels, pitch);
 	}
 }
 
@@ -144,6 +140,18 @@ void Renderer_TextureUnlock(Renderer_Texture *texture)
 	SDL_UnlockTexture(texture->sdl_texture);
 }
 
+void Renderer_TextureAbandonLock(Renderer_Texture *texture)
+{
+	/* SDL cannot release a lock without uploading it, so the locked area is left with whatever was in the lock. */
+	SDL_UnlockTexture(texture->sdl_texture);
+}
+
+cc_bool Renderer_TextureCanAbandonLock(void)
+{
+	/* SDL's locks are write-only, so abandoning one would fill the texture with garbage. */
+	return cc_false;
+}
+
 void Renderer_TextureDraw(Renderer_Texture *texture, const Renderer_Rect *dst_rect, const Renderer_Rect *src_rect, Renderer_Colour colour)
 {
 	SDL_Rect src_sdl_rect, dst_sdl_rect;
@@ -44,8 +44,11 @@ void Renderer_WindowResized(int width, int height);
 cc_bool Renderer_TextureCreate(Renderer_Texture *texture, size_t width, size_t height, Renderer_Format format, cc_bool streaming);
 void Renderer_TextureDestroy(Renderer_Texture *texture);
 void Renderer_TextureUpdate(Renderer_Texture *texture, const void *pixels, const Renderer_Rect *rect);
+void Renderer_TextureUpdatePitched(Renderer_Texture *texture, const void *pixels, const Renderer_Rect *rect, size_t pitch);
 cc_bool Renderer_TextureLock(Renderer_Texture *texture, const Renderer_Rect *rect, unsigned char **buffer, size_t *pitch);
 void Renderer_TextureUnlock(Renderer_Texture *texture);
+void Renderer_TextureAbandonLock(Renderer_Texture *texture);
+cc_bool Renderer_TextureCanAbandonLock(void);
 void Renderer_TextureDraw(Renderer_Texture *texture, const Renderer_Rect *dst_rect, const Renderer_Rect *src_rect, Renderer_Colour colour);
 
 void Renderer_ColourFill(const Renderer_Rect *rect, Renderer_Colour colour, unsigned char alpha);
@@ -0,0 +1,304 @@
+#include "rewind.h"
+
+#include <stddef.h>
+
+#include "SDL.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define REWIND_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define REWIND_NEON
+#endif
+
+/* Savestates are compared in blocks of this many bytes, which matches the width of the vector registers. */
+#define BLOCK_SIZE 16
+
+#define SIZE_OF_LENGTH 4
+
+/* Each entry's payload is sandwiched between two copies of its length, so that the ring buffer can be walked in both directions. */
+#define ENTRY_OVERHEAD (SIZE_OF_LENGTH * 2)
+
+/* Every run of differing bytes costs two lengths, but every run after the first is preceded by at least one identical block which is not stored. */
+#define MAX_PAYLOAD_SIZE(state_size) ((state_size) + SIZE_OF_LENGTH * 2)
+
+static void WriteLength(unsigned char* const buffer, const size_t length)
+{
+	const Uint32 value = (Uint32)length;
+
+	SDL_memcpy(buffer, &value, sizeof(value));
+}
+
+static size_t ReadLength(const unsigned char* const buffer)
+{
+	Uint32 value;
+
+	SDL_memcpy(&value, buffer, sizeof(value));
+
+	return value;
+}
+
+/****************
+* Delta kernels *
+****************/
+
+static cc_bool BlocksEqual(const unsigned char* const a, const unsigned char* const b)
+{
+#if defined(REWIND_SSE2)
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b))) == 0xFFFF;
+#elif defined(REWIND_NEON)
+	const uint64x2_t difference = vreinterpretq_u64_u8(veorq_u8(vld1q_u8(a), vld1q_u8(b)));
+
+	return (vgetq_lane_u64(difference, 0) | vgetq_lane_u64(difference, 1)) == 0;
+#else
+	return SDL_memcmp(a, b, BLOCK_SIZE) == 0;
+#endif
+}
+
+static void XorBytes(unsigned char* const output, const unsigned char* const a, const unsigned char* const b, const size_t size)
+{
+	const size_t total_block_bytes = size - size % BLOCK_SIZE;
+	size_t i;
+
+	for (i = 0; i < total_block_bytes; i += BLOCK_SIZE)
+	{
+	#if defined(REWIND_SSE2)
+		_mm_storeu_si128((__m128i*)&output[i], _mm_xor_si128(_mm_loadu_si128((const __m128i*)&a[i]), _mm_loadu_si128((const __m128i*)&b[i])));
+	#elif defined(REWIND_NEON)
+		vst1q_u8(&output[i], veorq_u8(vld1q_u8(&a[i]), vld1q_u8(&b[i])));
+	#else
+		size_t j;
+
+		for (j = i; j < i + BLOCK_SIZE; ++j)
+			output[j] = a[j] ^ b[j];
+	#endif
+	}
+
+	for (; i < size; ++i)
+		output[i] = a[i] ^ b[i];
+}
+
+/* Returns the size of the chunk at 'position', or 0 if the chunk is identical in both states. */
+static size_t DifferingChunkSize(const unsigned char* const a, const unsigned char* const b, const size_t position, const size_t size)
+{
+	const size_t chunk_size = SDL_min(BLOCK_SIZE, size - position);
+
+	if (chunk_size == BLOCK_SIZE ? BlocksEqual(&a[position], &b[position]) : SDL_memcmp(&a[position], &b[position], chunk_size) == 0)
+		return 0;
+
+	return chunk_size;
+}
+
+/* The delta is a series of runs: the number of identical bytes to skip, the number of differing bytes, and then those bytes XOR'd together. */
+static size_t EncodeDelta(unsigned char* const output, const unsigned char* const new_state, const unsigned char* const old_state, const size_t size)
+{
+	size_t input_position = 0;
+	size_t output_position = 0;
+
+	for (;;)
+	{
+		size_t chunk_size;
+
+		const size_t identical_start = input_position;
+		size_t differing_start;
+
+		while (input_position < size && DifferingChunkSize(new_state, old_state, input_position, size) == 0)
+			input_position += SDL_min(BLOCK_SIZE, size - input_position);
+
+		if (input_position == size)
+			break;
+
+		differing_start = input_position;
+
+		while (input_position < size && (chunk_size = DifferingChunkSize(new_state, old_state, input_position, size)) != 0)
+			input_position += chunk_size;
+
+		WriteLength(&output[output_position + SIZE_OF_LENGTH * 0], differing_start - identical_start);
+		WriteLength(&output[output_position + SIZE_OF_LENGTH * 1], input_position - differing_start);
+		output_position += SIZE_OF_LENGTH * 2;
+
+		XorBytes(&output[output_position], &new_state[differing_start], &old_state[differing_start], input_position - differing_start);
+		output_position += input_position - differing_start;
+	}
+
+	return output_position;
+}
+
+static void ApplyDelta(unsigned char* const state, const unsigned char* const delta, const size_t delta_size)
+{
+	size_t delta_position = 0;
+	size_t state_position = 0;
+
+	while (delta_position < delta_size)
+	{
+		const size_t differing_size = ReadLength(&delta[delta_position + SIZE_OF_LENGTH * 1]);
+
+		state_position += ReadLength(&delta[delta_position + SIZE_OF_LENGTH * 0]);
+		delta_position += SIZE_OF_LENGTH * 2;
+
+		XorBytes(&state[state_position], &state[state_position], &delta[delta_position], differing_size);
+		state_position += differing_size;
+		delta_position += differing_size;
+	}
+}
+
+/**************
+* Ring buffer *
+**************/
+
+static void ResetRingBuffer(Rewind_State* const rewind)
+{
+	rewind->head = 0;
+	rewind->tail = 0;
+	rewind->wrap = 0;
+	rewind->wrapped = cc_false;
+	rewind->total_entries = 0;
+}
+
+static void DropOldestEntry(Rewind_State* const rewind)
+{
+	rewind->tail += ReadLength(&rewind->buffer[rewind->tail]) + ENTRY_OVERHEAD;
+
+	if (--rewind->total_entries == 0)
+	{
+		ResetRingBuffer(rewind);
+	}
+	else if (rewind->wrapped && rewind->tail == rewind->wrap)
+	{
+		rewind->tail = 0;
+		rewind->wrapped = cc_false;
+	}
+}
+
+static void MakeRoom(Rewind_State* const rewind, const size_t size)
+{
+	for (;;)
+	{
+		if (!rewind->wrapped)
+		{
+			if (rewind->buffer_size - rewind->head >= size)
+				break;
+
+			/* There is not enough space at the end of the buffer, so wrap around to the start of it. */
+			rewind->wrap = rewind->head;
+			rewind->head = 0;
+			rewind->wrapped = cc_true;
+		}
+		else
+		{
+			if (rewind->tail - rewind->head >= size)
+				break;
+
+			DropOldestEntry(rewind);
+		}
+	}
+}
+
+/*************
+* Main stuff *
+*************/
+
+cc_bool Rewind_Create(Rewind_State* const rewind, const size_t state_size, const size_t buffer_size)
+{
+	if (buffer_size >= MAX_PAYLOAD_SIZE(state_size) + ENTRY_OVERHEAD)
+	{
+		rewind->buffer = (unsigned char*)SDL_malloc(buffer_size);
+
+		if (rewind->buffer != NULL)
+		{
+			rewind->current_state = (unsigned char*)SDL_malloc(state_size);
+
+			if (rewind->current_state != NULL)
+			{
+				rewind->capture_state = (unsigned char*)SDL_malloc(state_size);
+
+				if (rewind->capture_state != NULL)
+				{
+					rewind->buffer_size = buffer_size;
+					rewind->state_size = state_size;
+					rewind->has_current_state = cc_false;
+
+					ResetRingBuffer(rewind);
+
+					return cc_true;
+				}
+
+				SDL_free(rewind->current_state);
+			}
+
+			SDL_free(rewind->buffer);
+		}
+	}
+
+	return cc_false;
+}
+
+void Rewind_Destroy(Rewind_State* const rewind)
+{
+	SDL_free(rewind->capture_state);
+	SDL_free(rewind->current_state);
+	SDL_free(rewind->buffer);
+}
+
+unsigned char* Rewind_GetCaptureBuffer(Rewind_State* const rewind)
+{
+	return rewind->capture_state;
+}
+
+void Rewind_Push(Rewind_State* const rewind)
+{
+	unsigned char* const new_state = rewind->capture_state;
+
+	if (rewind->has_current_state)
+	{
+		unsigned char *entry;
+		size_t payload_size;
+
+		MakeRoom(rewind, MAX_PAYLOAD_SIZE(rewind->state_size) + ENTRY_OVERHEAD);
+
+		/* The delta is encoded directly into the ring buffer, to avoid needing a scratch buffer. */
+		entry = &rewind->buffer[rewind->head];
+		payload_size = EncodeDelta(&entry[SIZE_OF_LENGTH], new_state, rewind->current_state, rewind->state_size);
+
+		WriteLength(&entry[0], payload_size);
+		WriteLength(&entry[SIZE_OF_LENGTH + payload_size], payload_size);
+
+		rewind->head += payload_size + ENTRY_OVERHEAD;
+		++rewind->total_entries;
+	}
+
+	/* The newly-captured state becomes the current state, and the old current state gets recycled for the next capture. */
+	rewind->capture_state = rewind->current_state;
+	rewind->current_state = new_state;
+	rewind->has_current_state = cc_true;
+}
+
+const unsigned char* Rewind_Pop(Rewind_State* const rewind)
+{
+	if (!rewind->has_current_state)
+		return NULL;
+
+	/* When there are no entries left, we are at the oldest state, so just keep returning it. */
+	if (rewind->total_entries != 0)
+	{
+		size_t payload_size;
+
+		if (rewind->wrapped && rewind->head == 0)
+		{
+			rewind->head = rewind->wrap;
+			rewind->wrapped = cc_false;
+		}
+
+		payload_size = ReadLength(&rewind->buffer[rewind->head - SIZE_OF_LENGTH]);
+		rewind->head -= payload_size + ENTRY_OVERHEAD;
+
+		/* XOR is its own inverse, so applying the delta to the newer state produces the older one. */
+		ApplyDelta(rewind->current_state, &rewind->buffer[rewind->head + SIZE_OF_LENGTH], payload_size);
+
+		if (--rewind->total_entries == 0)
+			ResetRingBuffer(rewind);
+	}
+
+	return rewind->current_state;
+}
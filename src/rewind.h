@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "clowncommon/clowncommon.h"
+
+typedef struct Rewind_State
+{
+	/* Ring buffer of delta-compressed savestates. */
+	unsigned char *buffer;
+	size_t buffer_size;
+	size_t head, tail, wrap;
+	cc_bool wrapped;
+	size_t total_entries;
+
+	/* The newest savestate, uncompressed, plus a spare buffer for the next one to be written into. */
+	unsigned char *current_state;
+	unsigned char *capture_state;
+	size_t state_size;
+	cc_bool has_current_state;
+} Rewind_State;
+
+cc_bool Rewind_Create(Rewind_State *rewind, size_t state_size, size_t buffer_size);
+void Rewind_Destroy(Rewind_State *rewind);
+unsigned char* Rewind_GetCaptureBuffer(Rewind_State *rewind);
+void Rewind_Push(Rewind_State *rewind);
+const unsigned char* Rewind_Pop(Rewind_State *rewind);
@@ -0,0 +1,87 @@
+#include "ring_buffer.h"
+
+#include <stddef.h>
+
+#include "SDL.h"
+
+/* Copies elements in or out of the buffer, splitting the copy in two if it crosses the end of the buffer. */
+static void CopyIn(RingBuffer* const ring_buffer, const size_t index, const unsigned char* const elements, const size_t total_elements)
+{
+	const size_t first_length = SDL_min(total_elements, ring_buffer->buffer_length - index);
+
+	SDL_memcpy(&ring_buffer->buffer[index * ring_buffer->element_size], elements, first_length * ring_buffer->element_size);
+	SDL_memcpy(ring_buffer->buffer, &elements[first_length * ring_buffer->element_size], (total_elements - first_length) * ring_buffer->element_size);
+}
+
+static void CopyOut(RingBuffer* const ring_buffer, const size_t index, unsigned char* const elements, const size_t total_elements)
+{
+	const size_t first_length = SDL_min(total_elements, ring_buffer->buffer_length - index);
+
+	SDL_memcpy(elements, &ring_buffer->buffer[index * ring_buffer->element_size], first_length * ring_buffer->element_size);
+	SDL_memcpy(&elements[first_length * ring_buffer->element_size], ring_buffer->buffer, (total_elements - first_length) * ring_buffer->element_size);
+}
+
+/*************
+* Main stuff *
+*************/
+
+cc_bool RingBuffer_Create(RingBuffer* const ring_buffer, const size_t element_size, const size_t capacity)
+{
+	ring_buffer->element_size = element_size;
+	ring_buffer->buffer_length = capacity + 1;
+	ring_buffer->buffer = (unsigned char*)SDL_malloc(element_size * ring_buffer->buffer_length);
+
+	SDL_AtomicSet(&ring_buffer->read_index, 0);
+	SDL_AtomicSet(&ring_buffer->write_index, 0);
+
+	return ring_buffer->buffer != NULL;
+}
+
+void RingBuffer_Destroy(RingBuffer* const ring_buffer)
+{
+	SDL_free(ring_buffer->buffer);
+}
+
+size_t RingBuffer_GetTotalReadable(RingBuffer* const ring_buffer)
+{
+	const size_t read_index = (size_t)SDL_AtomicGet(&ring_buffer->read_index);
+	const size_t write_index = (size_t)SDL_AtomicGet(&ring_buffer->write_index);
+
+	return (write_index + ring_buffer->buffer_length - read_index) % ring_buffer->buffer_length;
+}
+
+size_t RingBuffer_GetTotalWritable(RingBuffer* const ring_buffer)
+{
+	return ring_buffer->buffer_length - 1 - RingBuffer_GetTotalReadable(ring_buffer);
+}
+
+/* Only to be called by the producer. Returns how many elements were actually written. */
+size_t RingBuffer_Write(RingBuffer* const ring_buffer, const void* const elements, const size_t total_elements)
+{
+	/* This must be read once, as the consumer may change it at any moment (and SDL_min evaluates its arguments twice). */
+	const size_t total_writable = RingBuffer_GetTotalWritable(ring_buffer);
+	const size_t write_index = (size_t)SDL_AtomicGet(&ring_buffer->write_index);
+	const size_t total_to_write = SDL_min(total_elements, total_writable);
+
+	CopyIn(ring_buffer, write_index, (const unsigned char*)elements, total_to_write);
+
+	/* SDL's atomic operations are full memory barriers, so the consumer will not see the new index before the data. */
+	SDL_AtomicSet(&ring_buffer->write_index, (int)((write_index + total_to_write) % ring_buffer->buffer_length));
+
+	return total_to_write;
+}
+
+/* Only to be called by the consumer. Returns how many elements were actually read. */
+size_t RingBuffer_Read(RingBuffer* const ring_buffer, void* const elements, const size_t total_elements)
+{
+	/* Likewise, the producer may change this at any moment. */
+	const size_t total_readable = RingBuffer_GetTotalReadable(ring_buffer);
+	const size_t read_index = (size_t)SDL_AtomicGet(&ring_buffer->read_index);
+	const size_t total_to_read = SDL_min(total_elements, total_readable);
+
+	CopyOut(ring_buffer, read_index, (unsigned char*)elements, total_to_read);
+
+	SDL_AtomicSet(&ring_buffer->read_index, (int)((read_index + total_to_read) % ring_buffer->buffer_length));
+
+	return total_to_read;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "SDL.h"
+
+#include "clowncommon/clowncommon.h"
+
+/* A lock-free queue of fixed-size elements, for passing data from exactly one producer thread to exactly one consumer thread. */
+typedef struct RingBuffer
+{
+	unsigned char *buffer;
+	size_t element_size;
+	size_t buffer_length; /* One more than the capacity, so that a full buffer can be told apart from an empty one. */
+	SDL_atomic_t read_index, write_index;
+} RingBuffer;
+
+cc_bool RingBuffer_Create(RingBuffer *ring_buffer, size_t element_size, size_t capacity);
+void RingBuffer_Destroy(RingBuffer *ring_buffer);
+size_t RingBuffer_GetTotalReadable(RingBuffer *ring_buffer);
+size_t RingBuffer_GetTotalWritable(RingBuffer *ring_buffer);
+size_t RingBuffer_Write(RingBuffer *ring_buffer, const void *elements, size_t total_elements);
+size_t RingBuffer_Read(RingBuffer *ring_buffer, void *elements, size_t total_elements);
@@ -0,0 +1,355 @@
+#include "savestate.h"
+
+#include <stddef.h>
+
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "SDL.h"
+
+#include "error.h"
+#include "file.h"
+#include "profiler.h"
+#include "ring_buffer.h"
+
+/* Savestates are double-buffered, so that one can be written while the worker is still busy with the last. */
+#define TOTAL_BUFFERS 2
+
+#define HEADER_SIZE 16
+#define HEADER_VERSION 1
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_ZSTD 1
+
+/* Speed matters far more than size here. */
+#define ZSTD_LEVEL 1
+
+typedef struct Job
+{
+	unsigned int buffer;
+	size_t state_size;
+	char *file_path;
+} Job;
+
+static const unsigned char magic[4] = {'C', 'L', 'S', 'S'};
+
+static SDL_Thread *worker_thread;
+static SDL_sem *job_semaphore;
+static RingBuffer job_queue;
+
+static unsigned char *buffers[TOTAL_BUFFERS];
+static size_t buffer_capacities[TOTAL_BUFFERS];
+static SDL_atomic_t buffers_busy[TOTAL_BUFFERS];
+static unsigned int current_buffer;
+
+#ifdef ENABLE_ZSTD
+/* Only the worker thread touches this. */
+static unsigned char *file_buffer;
+static size_t file_buffer_capacity;
+
+/* Compressed savestates get decompressed into this, while uncompressed ones are used straight out of the mapped file. */
+static unsigned char *load_buffer;
+static size_t load_buffer_capacity;
+#endif
+
+static MappedFile load_file;
+
+static void WriteU32LE(unsigned char* const buffer, const size_t value)
+{
+	buffer[0] = (value >> (8 * 0)) & 0xFF;
+	buffer[1] = (value >> (8 * 1)) & 0xFF;
+	buffer[2] = (value >> (8 * 2)) & 0xFF;
+	buffer[3] = (value >> (8 * 3)) & 0xFF;
+}
+
+static size_t ReadU32LE(const unsigned char* const buffer)
+{
+	return (size_t)buffer[0] << (8 * 0) | (size_t)buffer[1] << (8 * 1) | (size_t)buffer[2] << (8 * 2) | (size_t)buffer[3] << (8 * 3);
+}
+
+static cc_bool EnsureCapacity(unsigned char** const buffer, size_t* const capacity, const size_t size)
+{
+	if (*capacity < size)
+	{
+		unsigned char* const new_buffer = (unsigned char*)SDL_realloc(*buffer, size);
+
+		if (new_buffer != NULL)
+		{
+			*buffer = new_buffer;
+			*capacity = size;
+		}
+	}
+
+	return *capacity >= size;
+}
+
+/* The header is the magic, the format version, the compression method, the size of the savestate, and the size of the data that follows. */
+static void WriteHeader(unsigned char* const header, const unsigned int compression, const size_t state_size, const size_t payload_size)
+{
+	SDL_memcpy(&header[0], magic, sizeof(magic));
+	header[4] = HEADER_VERSION;
+	header[5] = compression;
+	header[6] = 0;
+	header[7] = 0;
+	WriteU32LE(&header[8], state_size);
+	WriteU32LE(&header[12], payload_size);
+}
+
+/***************
+* Worker stuff *
+***************/
+
+static void WriteStateFile(const char* const file_path, const unsigned char* const state, const size_t state_size)
+{
+#ifdef ENABLE_ZSTD
+	if (!EnsureCapacity(&file_buffer, &file_buffer_capacity, HEADER_SIZE + ZSTD_compressBound(state_size)))
+	{
+		PrintError("Could not allocate memory for the savestate compression buffer");
+	}
+	else
+	{
+		const size_t compressed_size = ZSTD_compress(&file_buffer[HEADER_SIZE], file_buffer_capacity - HEADER_SIZE, state, state_size, ZSTD_LEVEL);
+
+		if (ZSTD_isError(compressed_size))
+		{
+			PrintError("Could not compress savestate - Error: '%s'", ZSTD_getErrorName(compressed_size));
+		}
+		else
+		{
+			WriteHeader(file_buffer, COMPRESSION_ZSTD, state_size, compressed_size);
+
+			if (!WriteBufferToFile(file_path, file_buffer, HEADER_SIZE + compressed_size))
+				PrintError("Could not write savestate file '%s'", file_path);
+			else
+				PrintInfo("Savestate written to '%s'", file_path);
+		}
+	}
+#else
+	SDL_RWops *file;
+	unsigned char header[HEADER_SIZE];
+
+	WriteHeader(header, COMPRESSION_NONE, state_size, state_size);
+
+	file = SDL_RWFromFile(file_path, "wb");
+
+	if (file == NULL || SDL_RWwrite(file, header, HEADER_SIZE, 1) != 1 || SDL_RWwrite(file, state, state_size, 1) != 1)
+		PrintError("Could not write savestate file '%s'", file_path);
+	else
+		PrintInfo("Savestate written to '%s'", file_path);
+
+	if (file != NULL)
+		SDL_RWclose(file);
+#endif
+}
+
+static int WorkerThread(void* const user_data)
+{
+	(void)user_data;
+
+	Profiler_NameThread("Savestate worker");
+
+	for (;;)
+	{
+		Job job;
+
+		SDL_SemWait(job_semaphore);
+
+		/* Being woken up without a job means that it is time to quit. */
+		if (RingBuffer_Read(&job_queue, &job, 1) == 0)
+			break;
+
+		Profiler_Begin("Write savestate");
+		WriteStateFile(job.file_path, buffers[job.buffer], job.state_size);
+		Profiler_End();
+
+		SDL_free(job.file_path);
+		SDL_AtomicSet(&buffers_busy[job.buffer], 0);
+	}
+
+	return 0;
+}
+
+/*************
+* Main stuff *
+*************/
+
+cc_bool SaveState_Init(const size_t state_size)
+{
+	unsigned int i;
+
+	/* Allocate the buffers up-front, so that saving does not have to. */
+	for (i = 0; i < TOTAL_BUFFERS; ++i)
+	{
+		SDL_AtomicSet(&buffers_busy[i], 0);
+		EnsureCapacity(&buffers[i], &buffer_capacities[i], state_size);
+	}
+
+#ifdef ENABLE_ZSTD
+	EnsureCapacity(&load_buffer, &load_buffer_capacity, state_size);
+#endif
+
+	job_semaphore = SDL_CreateSemaphore(0);
+
+	if (job_semaphore == NULL)
+	{
+		PrintError("SDL_CreateSemaphore failed - Error: '%s'", SDL_GetError());
+	}
+	else
+	{
+		if (!RingBuffer_Create(&job_queue, sizeof(Job), TOTAL_BUFFERS))
+		{
+			PrintError("Could not allocate memory for the savestate job queue");
+		}
+		else
+		{
+			worker_thread = SDL_CreateThread(WorkerThread, "Savestate worker", NULL);
+
+			if (worker_thread != NULL)
+				return cc_true;
+
+			PrintError("SDL_CreateThread failed - Error: '%s'", SDL_GetError());
+
+			RingBuffer_Destroy(&job_queue);
+		}
+
+		SDL_DestroySemaphore(job_semaphore);
+	}
+
+	return cc_false;
+}
+
+void SaveState_Deinit(void)
+{
+	unsigned int i;
+
+	/* Let the worker finish any savestates that are still queued up before it quits. */
+	SDL_SemPost(job_semaphore);
+	SDL_WaitThread(worker_thread, NULL);
+
+	RingBuffer_Destroy(&job_queue);
+	SDL_DestroySemaphore(job_semaphore);
+
+	for (i = 0; i < TOTAL_BUFFERS; ++i)
+	{
+		SDL_free(buffers[i]);
+		buffers[i] = NULL;
+		buffer_capacities[i] = 0;
+	}
+
+#ifdef ENABLE_ZSTD
+	SDL_free(file_buffer);
+	file_buffer = NULL;
+	file_buffer_capacity = 0;
+
+	SDL_free(load_buffer);
+	load_buffer = NULL;
+	load_buffer_capacity = 0;
+#endif
+}
+
+/* Returns a buffer for the core to serialise into, or NULL if the worker is still busy with both of them. */
+unsigned char* SaveState_BeginSave(const size_t state_size)
+{
+	unsigned int i;
+
+	for (i = 0; i < TOTAL_BUFFERS; ++i)
+	{
+		if (!SDL_AtomicGet(&buffers_busy[i]) && EnsureCapacity(&buffers[i], &buffer_capacities[i], state_size))
+		{
+			current_buffer = i;
+			return buffers[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Hands the buffer to the worker, which compresses it and writes it to a file. */
+void SaveState_EndSave(const char* const file_path, const size_t state_size)
+{
+	Job job;
+
+	job.buffer = current_buffer;
+	job.state_size = state_size;
+	job.file_path = SDL_strdup(file_path);
+
+	if (job.file_path == NULL)
+	{
+		PrintError("Could not allocate memory for the savestate file path");
+	}
+	else
+	{
+		SDL_AtomicSet(&buffers_busy[current_buffer], 1);
+
+		/* There is a slot in the queue for every buffer, so this cannot fail. */
+		RingBuffer_Write(&job_queue, &job, 1);
+		SDL_SemPost(job_semaphore);
+	}
+}
+
+/* Returns the uncompressed savestate, which stays valid until 'SaveState_EndLoad' is called. */
+const unsigned char* SaveState_BeginLoad(const char* const file_path, size_t* const state_size)
+{
+	const unsigned char *state = NULL;
+
+	if (!MapFile(file_path, &load_file))
+	{
+		PrintError("Could not open savestate file '%s'", file_path);
+	}
+	else
+	{
+		const unsigned char* const header = load_file.data;
+
+		if (load_file.size < HEADER_SIZE || SDL_memcmp(header, magic, sizeof(magic)) != 0 || header[4] != HEADER_VERSION || ReadU32LE(&header[12]) > load_file.size - HEADER_SIZE)
+		{
+			PrintError("Savestate file '%s' is invalid", file_path);
+		}
+		else
+		{
+			const unsigned char* const payload = &load_file.data[HEADER_SIZE];
+			const size_t payload_size = ReadU32LE(&header[12]);
+
+			*state_size = ReadU32LE(&header[8]);
+
+			switch (header[5])
+			{
+				case COMPRESSION_NONE:
+					/* The mapped file can be handed to the core as-is. */
+					if (payload_size != *state_size)
+						PrintError("Savestate file '%s' is truncated", file_path);
+					else
+						state = payload;
+
+					break;
+
+			#ifdef ENABLE_ZSTD
+				case COMPRESSION_ZSTD:
+					/* Decompress straight into the buffer that the core will read from. */
+					if (!EnsureCapacity(&load_buffer, &load_buffer_capacity, *state_size))
+						PrintError("Could not allocate memory for the savestate");
+					else if (ZSTD_decompress(load_buffer, *state_size, payload, payload_size) != *state_size)
+						PrintError("Savestate file '%s' could not be decompressed", file_path);
+					else
+						state = load_buffer;
+
+					break;
+			#endif
+
+				default:
+					PrintError("Savestate file '%s' uses an unsupported compression method", file_path);
+					break;
+			}
+		}
+
+		if (state == NULL)
+			UnmapFile(&load_file);
+	}
+
+	return state;
+}
+
+void SaveState_EndLoad(void)
+{
+	UnmapFile(&load_file);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "clowncommon/clowncommon.h"
+
+cc_bool SaveState_Init(size_t state_size);
+void SaveState_Deinit(void);
+unsigned char* SaveState_BeginSave(size_t state_size);
+void SaveState_EndSave(const char *file_path, size_t state_size);
+const unsigned char* SaveState_BeginLoad(const char *file_path, size_t *state_size);
+void SaveState_EndLoad(void);
@@ -5,6 +5,8 @@
 #include "SDL.h"
 
 #include "error.h"
+#include "latency_meter.h"
+#include "profiler.h"
 
 size_t window_width;
 size_t window_height;
@@ -13,6 +15,18 @@ static SDL_Window *window;
 
 static cc_bool sdl_already_initialised;
 
+/* When headless, nothing is ever drawn, but texture locks still need somewhere to write to. */
+static cc_bool headless;
+static unsigned char *headless_lock_buffer;
+static size_t headless_lock_buffer_size;
+
+static size_t BytesPerPixel(const Video_Format format)
+{
+	static const size_t sizes[] = {2, 4, 2, 1};
+
+	return sizes[format];
+}
+
 /*************
 * Main stuff *
 *************/
@@ -45,36 +59,223 @@ cc_bool Video_Init(size_t window_width, size_t window_height)
 	return cc_false;
 }
 
+cc_bool Video_InitHeadless(const size_t _window_width, const size_t _window_height)
+{
+	headless = cc_true;
+
+	window_width = _window_width;
+	window_height = _window_height;
+
+	return cc_true;
+}
+
 void Video_Deinit(void)
 {
-	Renderer_Deinit();
+	if (headless)
+	{
+		SDL_free(headless_lock_buffer);
+		headless_lock_buffer = NULL;
+		headless_lock_buffer_size = 0;
+		headless = cc_false;
+	}
+	else
+	{
+		Renderer_Deinit();
 
-	SDL_DestroyWindow(window);
+		SDL_DestroyWindow(window);
 
-	if (!sdl_already_initialised)
-		SDL_QuitSubSystem(SDL_INIT_VIDEO);
+		if (!sdl_already_initialised)
+			SDL_QuitSubSystem(SDL_INIT_VIDEO);
+	}
+}
+
+void Video_Clear(void)
+{
+	if (!headless)
+		Renderer_Clear();
+}
+
+void Video_Display(void)
+{
+	if (!headless)
+		Renderer_Display();
+
+	LatencyMeter_FramePresented();
 }
 
 void Video_SetFullscreen(cc_bool fullscreen)
 {
-	SDL_SetWindowFullscreen(window, fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
+	if (!headless)
+	{
+		SDL_SetWindowFullscreen(window, fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
 
-	SDL_ShowCursor(fullscreen ? SDL_DISABLE : SDL_ENABLE);
+		SDL_ShowCursor(fullscreen ? SDL_DISABLE : SDL_ENABLE);
+	}
 }
 
 void Video_WindowResized(void)
 {
 	int width, height;
-	SDL_GetWindowSizeInPixels(window, &width, &height);
-	window_width = width;
-	window_height = height;
-	Renderer_WindowResized(width, height);
+
+	if (!headless)
+	{
+		SDL_GetWindowSizeInPixels(window, &width, &height);
+		window_width = width;
+		window_height = height;
+		Renderer_WindowResized(width, height);
+	}
 }
 
 float Video_GetDPIScale(void)
 {
 	int renderer_width, window_width;
+
+	if (headless)
+		return 1.0f;
+
 	SDL_GetWindowSizeInPixels(window, &renderer_width, NULL);
 	SDL_GetWindowSize(window, &window_width, NULL);
 	return (float)renderer_width / window_width;
 }
+
+/****************
+* Texture stuff *
+****************/
+
+cc_bool Video_TextureCreate(Video_Texture* const texture, const size_t width, const size_t height, const Video_Format format, const cc_bool streaming)
+{
+	if (headless)
+	{
+		texture->format = format;
+		return cc_true;
+	}
+
+	return Renderer_TextureCreate(texture, width, height, format, streaming);
+}
+
+void Video_TextureDestroy(Video_Texture* const texture)
+{
+	if (!headless)
+		Renderer_TextureDestroy(texture);
+}
+
+void Video_TextureUpdate(Video_Texture* const texture, const void* const pixels, const Video_Rect* const rect)
+{
+	if (!headless)
+		Renderer_TextureUpdate(texture, pixels, rect);
+}
+
+void Video_TextureUpdatePitched(Video_Texture* const texture, const void* const pixels, const Video_Rect* const rect, const size_t pitch)
+{
+	if (!headless)
+		Renderer_TextureUpdatePitched(texture, pixels, rect, pitch);
+}
+
+cc_bool Video_TextureLock(Video_Texture* const texture, const Video_Rect* const rect, unsigned char** const buffer, size_t* const pitch)
+{
+	if (headless)
+	{
+		const size_t size = rect->width * rect->height * BytesPerPixel(texture->format);
+
+		/* Only ever grow the buffer, so that there is not an allocation every frame. */
+		if (size > headless_lock_buffer_size)
+		{
+			unsigned char* const new_buffer = (unsigned char*)SDL_realloc(headless_lock_buffer, size);
+
+			if (new_buffer == NULL)
+				return cc_false;
+
+			headless_lock_buffer = new_buffer;
+			headless_lock_buffer_size = size;
+		}
+
+		*buffer = headless_lock_buffer;
+		*pitch = rect->width * BytesPerPixel(texture->format);
+
+		return cc_true;
+	}
+
+	return Renderer_TextureLock(texture, rect, buffer, pitch);
+}
+
+void Video_TextureUnlock(Video_Texture* const texture)
+{
+	/* This is usually where the texture actually gets uploaded. */
+	Profiler_Begin("Video_TextureUnlock");
+
+	if (!headless)
+		Renderer_TextureUnlock(texture);
+
+	Profiler_End();
+}
+
+/* Releases a lock without uploading anything, for when nothing that was written to it is wanted. */
+void Video_TextureAbandonLock(Video_Texture* const texture)
+{
+	if (!headless)
+		Renderer_TextureAbandonLock(texture);
+}
+
+/* Whether abandoning a lock leaves the texture as it was. If not, then a lock is only safe to hand out if it is certain to be submitted. */
+cc_bool Video_TextureCanAbandonLock(void)
+{
+	return headless || Renderer_TextureCanAbandonLock();
+}
+
+void Video_TextureDraw(Video_Texture* const texture, const Video_Rect* const dst_rect, const Video_Rect* const src_rect, const Video_Colour colour)
+{
+	if (!headless)
+		Renderer_TextureDraw(texture, dst_rect, src_rect, colour);
+}
+
+void Video_ColourFill(const Video_Rect* const rect, const Video_Colour colour, const unsigned char alpha)
+{
+	if (!headless)
+		Renderer_ColourFill(rect, colour, alpha);
+}
+
+void Video_DrawLine(const size_t x1, const size_t y1, const size_t x2, const size_t y2)
+{
+	if (!headless)
+		Renderer_DrawLine(x1, y1, x2, y2);
+}
+
+/********************
+* Framebuffer stuff *
+********************/
+
+cc_bool Video_FramebufferCreateSoftware(Video_Framebuffer* const framebuffer, const size_t width, const size_t height, const Video_Format format, const cc_bool streaming)
+{
+	if (headless)
+		return Video_TextureCreate(Renderer_FramebufferTexture(framebuffer), width, height, format, streaming);
+
+	return Renderer_FramebufferCreateSoftware(framebuffer, width, height, format, streaming);
+}
+
+cc_bool Video_FramebufferCreateHardware(Video_Framebuffer* const framebuffer, const size_t width, const size_t height, const cc_bool depth, const cc_bool stencil)
+{
+	/* Hardware-rendered cores need a real graphics context. */
+	if (headless)
+		return cc_false;
+
+	return Renderer_FramebufferCreateHardware(framebuffer, width, height, depth, stencil);
+}
+
+void Video_FramebufferDestroy(Video_Framebuffer* const framebuffer)
+{
+	if (!headless)
+		Renderer_FramebufferDestroy(framebuffer);
+}
+
+Video_Texture* Video_FramebufferTexture(Video_Framebuffer* const framebuffer)
+{
+	return Renderer_FramebufferTexture(framebuffer);
+}
+
+void* Video_FramebufferNative(Video_Framebuffer* const framebuffer)
+{
+	if (headless)
+		return NULL;
+
+	return Renderer_FramebufferNative(framebuffer);
+}
@@ -16,6 +16,7 @@ extern size_t window_width;
 extern size_t window_height;
 
 cc_bool Video_Init(size_t window_width, size_t window_height);
+cc_bool Video_InitHeadless(size_t window_width, size_t window_height);
 void Video_Deinit(void);
 void Video_Clear(void);
 void Video_Display(void);
@@ -23,20 +24,20 @@ void Video_SetFullscreen(cc_bool fullscreen);
 void Video_WindowResized(void);
 float Video_GetDPIScale(void);
 
-#define Video_Clear Renderer_Clear
-#define Video_Display Renderer_Display
-
-#define Video_TextureCreate Renderer_TextureCreate
-#define Video_TextureDestroy Renderer_TextureDestroy
-#define Video_TextureUpdate Renderer_TextureUpdate
-#define Video_TextureLock Renderer_TextureLock
-#define Video_TextureUnlock Renderer_TextureUnlock
-#define Video_TextureDraw Renderer_TextureDraw
-#define Video_ColourFill Renderer_ColourFill
-#define Video_DrawLine Renderer_DrawLine
-
-#define Video_FramebufferCreateSoftware Renderer_FramebufferCreateSoftware
-#define Video_FramebufferCreateHardware Renderer_FramebufferCreateHardware
-#define Video_FramebufferDestroy Renderer_FramebufferDestroy
-#define Video_FramebufferTexture Renderer_FramebufferTexture
-#define Video_FramebufferNative Renderer_FramebufferNative
+cc_bool Video_TextureCreate(Video_Texture *texture, size_t width, size_t height, Video_Format format, cc_bool streaming);
+void Video_TextureDestroy(Video_Texture *texture);
+void Video_TextureUpdate(Video_Texture *texture, const void *pixels, const Video_Rect *rect);
+void Video_TextureUpdatePitched(Video_Texture *texture, const void *pixels, const Video_Rect *rect, size_t pitch);
+cc_bool Video_TextureLock(Video_Texture *texture, const Video_Rect *rect, unsigned char **buffer, size_t *pitch);
+void Video_TextureUnlock(Video_Texture *texture);
+void Video_TextureAbandonLock(Video_Texture *texture);
+cc_bool Video_TextureCanAbandonLock(void);
+void Video_TextureDraw(Video_Texture *texture, const Video_Rect *dst_rect, const Video_Rect *src_rect, Video_Colour colour);
+void Video_ColourFill(const Video_Rect *rect, Video_Colour colour, unsigned char alpha);
+void Video_DrawLine(size_t x1, size_t y1, size_t x2, size_t y2);
+
+cc_bool Video_FramebufferCreateSoftware(Video_Framebuffer *framebuffer, size_t width, size_t height, Video_Format format, cc_bool streaming);
+cc_bool Video_FramebufferCreateHardware(Video_Framebuffer *framebuffer, size_t width, size_t height, cc_bool depth, cc_bool stencil);
+void Video_FramebufferDestroy(Video_Framebuffer *framebuffer);
+Video_Texture* Video_FramebufferTexture(Video_Framebuffer *framebuffer);
+void* Video_FramebufferNative(Video_Framebuffer *framebuffer);